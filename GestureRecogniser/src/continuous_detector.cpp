@@ -0,0 +1,76 @@
+#include "continuous_detector.hpp"
+
+void ContinuousDetector::sample()
+{
+    uint16_t sample[NUM_LIGHT_SENSORS];
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        sample[i] = analogRead(PHOTO_DIODE_PINS[i]);
+        history[i].push(sample[i]);
+    }
+
+    if (sampleCallback != nullptr)
+        sampleCallback(sample);
+
+    samplesSinceWindow++;
+
+    if (suppressedSamples > 0)
+    {
+        suppressedSamples--;
+        samplesSinceWindow = 0;
+        return;
+    }
+
+    // Only classify full windows, and only once every hop samples
+    if (!history[0].full() || samplesSinceWindow < hopSize)
+        return;
+
+    samplesSinceWindow = 0;
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+        history[i].copyTo(CaptureLayout::Channel(window, i), GESTURE_BUFFER_LENGTH, CaptureLayout::STRIDE);
+
+    if (windowCallback != nullptr)
+        windowCallback(window);
+}
+
+void ContinuousDetector::applyGainChange(float ratio)
+{
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        if (ratio <= 0)
+        {
+            history[i].clear();
+            continue;
+        }
+
+        // Rounded and clipped to the range of the ADC, like the gesture detector rescales its history
+        for (size_t j = 0; j < history[i].size(); j++)
+        {
+            float scaled = history[i][j] * ratio + 0.5f;
+            history[i][j] = scaled > ADC_MAX_READING ? ADC_MAX_READING : (uint16_t)scaled;
+        }
+    }
+}
+
+void ContinuousDetector::selectHopSize(unsigned long inferenceDurationUs)
+{
+    // The inference of one window may take at most CONTINUOUS_DUTY_CYCLE_BUDGET of the time between two windows
+    const float samplePeriodUs = readPeriod * 1000.0f;
+    uint16_t hop = (uint16_t) ceil(inferenceDurationUs / (CONTINUOUS_DUTY_CYCLE_BUDGET * samplePeriodUs));
+
+    if (hop < CONTINUOUS_MIN_HOP)
+        hop = CONTINUOUS_MIN_HOP;
+    if (hop > GESTURE_BUFFER_LENGTH)
+        hop = GESTURE_BUFFER_LENGTH;
+
+    hopSize = hop;
+
+    #ifdef DEBUG_PRINTS
+    Serial.print("Inference takes ");
+    Serial.print(inferenceDurationUs);
+    Serial.print(" microseconds, classifying a window every ");
+    Serial.print(hopSize);
+    Serial.println(" samples.");
+    #endif // DEBUG_PRINTS
+}
\ No newline at end of file
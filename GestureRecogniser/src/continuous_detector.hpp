@@ -0,0 +1,69 @@
+#ifndef CONTINUOUS_DETECTOR_HPP
+#define CONTINUOUS_DETECTOR_HPP
+
+#include <Arduino.h>
+
+#include <stdint.h>
+
+#include "global_constants.hpp"
+
+#include "util/ring_buffer.hpp"
+#include "util/capture_buffer.hpp"
+
+/**
+ * @brief An always-on alternative to the GestureDetector. Instead of waiting for an edge trigger it keeps the last
+ *        GESTURE_BUFFER_LENGTH samples of every light sensor in a ring buffer and hands an overlapping window
+ *        to the window callback every hop samples.
+ */
+class ContinuousDetector
+{
+public:
+    using WindowCallback = void (*)(const CaptureBuffer& photodiodeData);
+    // Called with every sample, before the window that ends with it is classified
+    using SampleCallback = void (*)(const uint16_t sample[NUM_LIGHT_SENSORS]);
+
+public:
+    ContinuousDetector() {}
+
+    void setWindowCallback(WindowCallback callback) { this->windowCallback = callback; }
+    void setSampleCallback(SampleCallback callback) { this->sampleCallback = callback; }
+
+    // Reads one sample of every light sensor and classifies a window when a hop has passed
+    void sample();
+
+    // Chooses the smallest hop for which the inference cost stays within CONTINUOUS_DUTY_CYCLE_BUDGET
+    void selectHopSize(unsigned long inferenceDurationUs);
+
+    // Rescales the samples in the window after the light sensors changed gain by the given ratio.
+    // A ratio of 0 means the change is unknown, the window is then collected again.
+    void applyGainChange(float ratio);
+
+    // Don't classify any window in the next number of samples, used to not detect the same gesture twice
+    void suppress(uint16_t samples) { suppressedSamples = samples; }
+
+    // Sampling period in milliseconds, used to turn the inference cost into a hop size
+    void setReadPeriod(unsigned long period) { this->readPeriod = period; }
+
+    uint16_t getHopSize() { return hopSize; }
+    void setHopSize(uint16_t hop) { this->hopSize = hop; }
+
+    // Copy of the most recent full window
+    const CaptureBuffer& getWindow() { return window; }
+
+private:
+    WindowCallback windowCallback = nullptr;
+    SampleCallback sampleCallback = nullptr;
+
+    RingBuffer<uint16_t, GESTURE_BUFFER_LENGTH> history[NUM_LIGHT_SENSORS];
+
+    // Contiguous copy of the ring buffers in CaptureLayout that is passed to the window callback
+    CaptureBuffer window = {};
+
+    unsigned long readPeriod = READ_PERIOD;
+
+    uint16_t hopSize = CONTINUOUS_MIN_HOP;
+    uint16_t samplesSinceWindow = 0;
+    uint16_t suppressedSamples = 0;
+};
+
+#endif // CONTINUOUS_DETECTOR_HPP
\ No newline at end of file
@@ -22,18 +22,18 @@ bool EdgeDetector::detectEdgeStart(uint16_t* signal)
     return true;
 }
 
-// Not used at this moment
-// bool EdgeDetector::detectEdgeEnd(uint16_t *signal)
-// {
-//     uint16_t count = m_detectionEndWindowLength;
+bool EdgeDetector::detectEdgeEnd(const uint16_t* signal, size_t stride)
+{
+    uint16_t count = m_detectionEndWindowLength;
+    uint16_t endThreshold = m_threshold * m_endThresholdCoeff;
 
-//     while (count > 0)
-//     {
-//         if (*signal < m_threshold)
-//             return false;
-//         signal--;
-//         count--;
-//     }
+    while (count > 0)
+    {
+        if (*signal < endThreshold)
+            return false;
+        signal -= stride;
+        count--;
+    }
 
-//     return true;
-// }
\ No newline at end of file
+    return true;
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef EDGE_DETECTOR_HPP
 #define EDGE_DETECTOR_HPP
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -10,10 +11,12 @@ class EdgeDetector
 {
 public:
     EdgeDetector() {}
-    EdgeDetector(uint16_t detWL, uint16_t detEWL, uint16_t t) : m_detectionWindowLength(detWL), m_detectionEndWindowLength(detEWL), m_threshold(t) {}
+    EdgeDetector(uint16_t detWL, uint16_t detEWL, uint16_t t, float endC = 1.0f) : m_detectionWindowLength(detWL), m_detectionEndWindowLength(detEWL), m_threshold(t), m_endThresholdCoeff(endC) {}
 
     bool detectEdgeStart(uint16_t* signal);
-    // bool detectEdgeEnd(uint16_t *signal);
+    // The end threshold is endC times the start threshold, the hysteresis keeps noise around the threshold from ending a gesture.
+    // The samples before the newest one are stride elements apart, for captures that interleave the light sensors.
+    bool detectEdgeEnd(const uint16_t* signal, size_t stride = 1);
 
     int getThreshold() { return m_threshold; }
     void setThreshold(uint16_t t) { this->m_threshold = t; }
@@ -22,6 +25,7 @@ private:
     uint16_t m_detectionWindowLength;
     uint16_t m_detectionEndWindowLength;
     uint16_t m_threshold;
+    float m_endThresholdCoeff;
 };
 
 #endif // EDGE_DETECTOR_HPP
\ No newline at end of file
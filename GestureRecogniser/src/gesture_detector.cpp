@@ -9,57 +9,44 @@ GestureDetector::GestureDetector()
     edgeDetectors = new EdgeDetector[NUM_LIGHT_SENSORS];
     for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
     {
-        photodiodeDataPtr[i] = photodiodeData[i];
         taBuffer[i] = thresholdAdjustmentBuffer[i];
-        edgeDetectors[i] = EdgeDetector(DETECTION_WINDOW_LENGTH, DETECTION_END_WINDOW_LENGTH, INITIAL_DETECTION_THRESHOLD);
+        edgeDetectors[i] = EdgeDetector(DETECTION_WINDOW_LENGTH, DETECTION_END_WINDOW_LENGTH, INITIAL_DETECTION_THRESHOLD, DETECTION_END_THRESHOLD_COEFF);
     }
 }
 
 void GestureDetector::detectGesture()
 {
-    if (detectionWindowFull == false)
+    #ifdef IDLE_SENSING
+    // Without activity only every IDLE_DECIMATION-th tick is sampled
+    if (idle && ++idleTicks < IDLE_DECIMATION)
+        return;
+    idleTicks = 0;
+    #endif // IDLE_SENSING
+
+    // The newest sample of every light sensor, passed to the sample callback
+    uint16_t sample[NUM_LIGHT_SENSORS];
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
     {
-        // If the detection window is not filled, fill it
-        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
-        {
-            uint16_t data = analogRead(PHOTO_DIODE_PINS[i]);
-            *photodiodeDataPtr[i] = data;
-            photodiodeDataPtr[i]++;
+        sample[i] = analogRead(PHOTO_DIODE_PINS[i]);
+        history[i].push(sample[i]);
 
-            *taBuffer[i] = data;
-            taBuffer[i]++;
-        }
+        *taBuffer[i] = sample[i];
+        taBuffer[i]++;
+    }
 
+    if (count < DETECTION_BUFFER_LENGTH)
         count++;
 
-        if (count == DETECTION_BUFFER_LENGTH)
-        {
-            // TODO: Get rid of this for loop
-            for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
-            {   
-                photodiodeDataPtr[i]--;
-            }
+    #ifdef IDLE_SENSING
+    updateIdleState(sample);
+    #endif // IDLE_SENSING
 
-            detectionWindowFull = true;
-        }
-    }
-    else
-    {
-        // If the detection window is already filled, shift all data left with 1
-        // and put the new sample in the last place
-        for (size_t pdId = 0; pdId < NUM_LIGHT_SENSORS; pdId++)
-            for (size_t i = 0; i < DETECTION_BUFFER_LENGTH - 1; i++)
-                photodiodeData[pdId][i] = photodiodeData[pdId][i + 1];
+    // Runs between gestures only, so it is safe to switch gains from the callback
+    if (sampleCallback != nullptr)
+        sampleCallback(sample);
 
-        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
-        {
-            uint16_t data = analogRead(PHOTO_DIODE_PINS[i]);
-            *photodiodeDataPtr[i] = data;
-            
-            *taBuffer[i] = data;
-            taBuffer[i]++;
-        }
-    }
+    monitorGain(sample);
 
     // If there was no gesture recently, update the threshold
     // This will happen every THRESHOLD_ADJ_BUFFER_LENGTH * READ_PERIOD ms (= 100 * 10 ms = 1000 ms)
@@ -69,11 +56,12 @@ void GestureDetector::detectGesture()
         recalibrateThresholds(true);
     }
 
-    // Only check for gesture if the detection window is full
-    if (!detectionWindowFull) 
+    // Only check for gesture once the detection window is filled again after the last gesture,
+    // and the history holds enough samples to fill the part of the capture before the trigger
+    if (count < DETECTION_BUFFER_LENGTH || history[0].size() < PRE_TRIGGER_LENGTH)
         return;
 
-    bool startEdgeDetected = detectGestureStart(photodiodeDataPtr);
+    bool startEdgeDetected = detectGestureStart();
 
     // Try to detect a start on one of the photodiodes
     if (startEdgeDetected)
@@ -83,54 +71,89 @@ void GestureDetector::detectGesture()
         Serial.println("--------------------");
         Serial.print("Gesture detected. Collecting data...");
 
-        // Read enough more data to avoid buffer overflow when checking end
-        // of gesture if more samples are checked for end than for start
-        while (count++ < DETECTION_END_WINDOW_LENGTH - DETECTION_BUFFER_LENGTH)
+        // The capture starts with the samples before the trigger, so the onset of the gesture is not lost
+        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+            history[i].copyTo(CaptureLayout::Channel(photodiodeData, i), PRE_TRIGGER_LENGTH, CaptureLayout::STRIDE);
+        captureLength = PRE_TRIGGER_LENGTH;
+
+        for (uint16_t j = 0; j < PRE_TRIGGER_LENGTH; j++)
+            feedCaptureSample(j);
+
+        // Set when a provisional prediction is committed before the capture is complete
+        bool committed = false;
+
+        // The capture keeps to a time grid of readPeriod, so a provisional inference that takes longer than a period
+        // does not shift the rest of the gesture in time. The ticks it missed are filled in by linear interpolation.
+        unsigned long nextTick = millis();
+
+        while (captureLength < GESTURE_BUFFER_LENGTH)
         {
+            // Allow for new data to come in
+            nextTick += readPeriod;
+            long wait = (long)(nextTick - millis());
+            if (wait > 0)
+                delay(wait);
+
+            // Ticks that passed while the last inference ran, the sample that is read now belongs to the last of them
+            uint16_t missed = wait < 0 ? -wait / readPeriod : 0;
+            if (missed > GESTURE_BUFFER_LENGTH - 1 - captureLength)
+                missed = GESTURE_BUFFER_LENGTH - 1 - captureLength;
+            nextTick += missed * readPeriod;
+
+            uint16_t index = captureLength + missed;
             for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
             {
-                photodiodeDataPtr[i]++;
+                CaptureLayout::At(photodiodeData, i, index) = analogRead(PHOTO_DIODE_PINS[i]);
 
-                uint16_t data = analogRead(PHOTO_DIODE_PINS[i]);
-                *photodiodeDataPtr[i] = data;
+                int previous = CaptureLayout::At(photodiodeData, i, captureLength - 1);
+                int difference = CaptureLayout::At(photodiodeData, i, index) - previous;
+                for (uint16_t j = captureLength; j < index; j++)
+                    CaptureLayout::At(photodiodeData, i, j) = previous + difference * (j - captureLength + 1) / (missed + 1);
             }
 
-            delay(READ_PERIOD);
-        }
-
-        // Read new data and check for end of gesture
-        while (count++ <= GESTURE_BUFFER_LENGTH)
-        {
-            for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+            for (uint16_t j = captureLength; j <= index; j++)
             {
-                photodiodeDataPtr[i]++;
-                uint16_t data = (uint16_t) analogRead(PHOTO_DIODE_PINS[i]);
+                // Keep the history running, it is the start of the next capture
+                for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+                    history[i].push(CaptureLayout::At(photodiodeData, i, j));
 
-                *photodiodeDataPtr[i] = data;
+                feedCaptureSample(j);
             }
 
-            // Allow for new data to come in
-            delay(READ_PERIOD);
+            uint16_t previousLength = captureLength;
+            captureLength = index + 1;
+
+            if ((committed = tryEarlyCommit(previousLength)))
+                break;
+
+            #ifdef ADAPTIVE_CAPTURE
+            if (captureLength >= MIN_CAPTURE_LENGTH && detectGestureEnd())
+                break;
+            #endif // ADAPTIVE_CAPTURE
         }
 
         Serial.println("Done.");
 
-        // Call the gestureDetectedCallback function with the gesture data
-        if (gestureDetectedCallback != nullptr)
+        // The model expects GESTURE_BUFFER_LENGTH samples
+        if (!committed && captureLength < GESTURE_BUFFER_LENGTH)
+            resampleCapture();
+
+        // Call the gestureDetectedCallback function with the gesture data,
+        // unless a provisional prediction was already committed
+        if (gestureDetectedCallback != nullptr && !committed)
             gestureDetectedCallback(photodiodeData);
 
-        // Reset the buffer pointers to the start of the buffers
-        detectionWindowFull = false;
+        // Reset the threshold adjustment buffers, the history keeps running
         for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
-        {
-            photodiodeDataPtr[i] = photodiodeData[i];
             taBuffer[i] = thresholdAdjustmentBuffer[i];
-        }
 
         recalibrateThresholds(false);
 
         count = 0;
 
+        // More gestures may follow, stay at the full rate for a while
+        quietSamples = 0;
+
         if (resetCallback != nullptr) 
         {
             resetCallback();
@@ -138,11 +161,27 @@ void GestureDetector::detectGesture()
     }
 }
 
-bool GestureDetector::detectGestureStart(uint16_t **signals)
+void GestureDetector::feedCaptureSample(uint16_t index)
+{
+    if (captureSampleCallback == nullptr)
+        return;
+
+    uint16_t sample[NUM_LIGHT_SENSORS];
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+        sample[i] = CaptureLayout::At(photodiodeData, i, index);
+
+    captureSampleCallback(sample, index);
+}
+
+bool GestureDetector::detectGestureStart()
 {
     for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
     {
-        if (edgeDetectors[i].detectEdgeStart(signals[i]))
+        // The edge detector walks back from the newest sample, so it needs the last samples in one piece
+        uint16_t recent[DETECTION_WINDOW_LENGTH];
+        history[i].copyTo(recent, DETECTION_WINDOW_LENGTH);
+
+        if (edgeDetectors[i].detectEdgeStart(&recent[DETECTION_WINDOW_LENGTH - 1]))
         {
             return true;
         }
@@ -151,19 +190,219 @@ bool GestureDetector::detectGestureStart(uint16_t **signals)
     return false;
 }
 
-// Not used at this moment
-// bool GestureDetector::detectGestureEnd(uint16_t **signals)
-// {
-//     for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
-//     {
-//         if (edgeDetectors[i].detectEdgeEnd(signals[i]))
-//         {
-//             return true;
-//         }
-//     }
-
-//     return false;
-// }
+// Adjusts the detector to a new gain of the light sensors, where ratio is the expected change of every reading.
+// The thresholds are rescaled in one go, so no sample is compared to a threshold of the other gain.
+// A ratio of 0 means the change is unknown and the thresholds are kept until they are re-learned.
+void GestureDetector::applyGainChange(float ratio)
+{
+    if (ratio <= 0)
+    {
+        // The change can't be predicted, the buffered samples were taken with the old gain: start collecting them again
+        count = 0;
+        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+        {
+            history[i].clear();
+            taBuffer[i] = thresholdAdjustmentBuffer[i];
+        }
+        return;
+    }
+
+    // Bring the thresholds and buffered samples to the new gain, so detection can continue without a restart
+    size_t taLength = taBuffer[0] - thresholdAdjustmentBuffer[0];
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        edgeDetectors[i].setThreshold(rescaleSample(edgeDetectors[i].getThreshold(), ratio));
+
+        for (size_t j = 0; j < history[i].size(); j++)
+            history[i][j] = rescaleSample(history[i][j], ratio);
+
+        for (size_t j = 0; j < taLength; j++)
+            thresholdAdjustmentBuffer[i][j] = rescaleSample(thresholdAdjustmentBuffer[i][j], ratio);
+    }
+}
+
+void GestureDetector::monitorGain(const uint16_t sample[NUM_LIGHT_SENSORS])
+{
+    if (gainStepCallback == nullptr)
+        return;
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        if (sample[i] >= CLIPPING_READING)
+            clippedSamples[i]++;
+        if (sample[i] > gainMonitorPeak)
+            gainMonitorPeak = sample[i];
+    }
+
+    if (++gainMonitorCount < GAIN_MONITOR_WINDOW)
+        return;
+
+    // Clipping loses the shadow of a gesture completely, so it goes before a weak signal
+    int direction = 0;
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        if (clippedSamples[i] > GAIN_MONITOR_WINDOW * MAX_CLIPPED_FRACTION)
+            direction = GAIN_STEP_DOWN;
+    }
+
+    if (direction == 0 && gainMonitorPeak < LOW_SIGNAL_READING)
+        direction = GAIN_STEP_UP;
+
+    gainMonitorCount = 0;
+    gainMonitorPeak = 0;
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+        clippedSamples[i] = 0;
+
+    if (direction == 0)
+        return;
+
+    // Clipped samples are rescaled from the clipping level, so the thresholds are too low until they are learned
+    // again, which only makes the detector less sensitive for a moment
+    float ratio = gainStepCallback(direction);
+    if (ratio != 1)
+        applyGainChange(ratio);
+}
+
+void GestureDetector::updateIdleState(const uint16_t sample[NUM_LIGHT_SENSORS])
+{
+    bool activity = false;
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        if (abs(sample[i] - previousSample[i]) > IDLE_CHANGE_THRESHOLD ||
+            sample[i] < edgeDetectors[i].getThreshold() * IDLE_ARM_MARGIN)
+            activity = true;
+
+        previousSample[i] = sample[i];
+    }
+
+    if (idle)
+    {
+        idleRateSamples++;
+
+        if (!activity)
+            return;
+
+        // Suspected motion, sample at the full rate from the next tick on
+        idle = false;
+        quietSamples = 0;
+
+        interpolateHistory();
+    }
+    else
+    {
+        quietSamples = activity ? 0 : quietSamples + 1;
+
+        if (quietSamples >= IDLE_HOLD_SAMPLES)
+        {
+            idle = true;
+            idleTicks = 0;
+            idleRateSamples = 0;
+        }
+    }
+}
+
+// The newest idleRateSamples entries of the history were taken every IDLE_DECIMATION ticks, the older ones every tick.
+// The last full rate entry is IDLE_DECIMATION ticks older than the first idle rate entry, and the anchor it is interpolated from.
+// Ticks older than the oldest entry repeat it.
+void GestureDetector::interpolateHistory()
+{
+    size_t size = history[0].size();
+    size_t idleEntries = idleRateSamples < size ? idleRateSamples : size;
+    if (idleEntries == 0 || size < 2)
+        return;
+
+    // Number of ticks between the newest sample and the entry that is j entries old
+    auto entryAge = [idleEntries](size_t j) {
+        return j < idleEntries ? j * IDLE_DECIMATION : idleEntries * IDLE_DECIMATION + (j - idleEntries);
+    };
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        // Before interpolating, the entry that is j entries old is at size - 1 - j
+        uint16_t entries[PRE_TRIGGER_LENGTH];
+        history[i].copyTo(entries, size);
+
+        // Fill the history from the newest tick back, between the two entries around every age
+        size_t j = 0;
+        for (size_t age = 0; age < size; age++)
+        {
+            while (j + 1 < size && entryAge(j + 1) <= age)
+                j++;
+
+            int newer = entries[size - 1 - j];
+            if (j + 1 == size)
+            {
+                history[i][size - 1 - age] = newer;
+                continue;
+            }
+
+            int difference = entries[size - 2 - j] - newer;
+            int span = entryAge(j + 1) - entryAge(j);
+            history[i][size - 1 - age] = newer + difference * (int)(age - entryAge(j)) / span;
+        }
+    }
+}
+
+uint16_t GestureDetector::rescaleSample(uint16_t sample, float ratio)
+{
+    float scaled = sample * ratio + 0.5f;
+    return scaled > ADC_MAX_READING ? ADC_MAX_READING : (uint16_t)scaled;
+}
+
+// Runs a provisional inference through the earlyCommitCallback when the number of captured samples passed a checkpoint
+// since previousLength. Samples missed during an earlier inference can make the capture skip over the checkpoint itself.
+// Returns true when the provisional result was committed and the capture should be ended.
+bool GestureDetector::tryEarlyCommit(uint16_t previousLength)
+{
+    #ifdef EARLY_PREDICTION
+    static const uint16_t checkpoints[NUM_EARLY_PREDICTION_CHECKPOINTS] = EARLY_PREDICTION_CHECKPOINTS;
+
+    if (earlyCommitCallback == nullptr)
+        return false;
+
+    for (size_t i = 0; i < NUM_EARLY_PREDICTION_CHECKPOINTS; i++)
+    {
+        if (checkpoints[i] > previousLength && checkpoints[i] <= captureLength)
+            return earlyCommitCallback(photodiodeData, captureLength);
+    }
+    #endif // EARLY_PREDICTION
+
+    return false;
+}
+
+// The shadow of a hand moves over the light sensors one after the other, so the gesture only ends
+// when the light has returned on all of them.
+bool GestureDetector::detectGestureEnd()
+{
+    for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        if (!edgeDetectors[i].detectEdgeEnd(&CaptureLayout::At(photodiodeData, i, captureLength - 1), CaptureLayout::STRIDE))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GestureDetector::resampleCapture()
+{
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        uint16_t captured[GESTURE_BUFFER_LENGTH];
+        uint16_t stretched[GESTURE_BUFFER_LENGTH];
+        for (size_t j = 0; j < captureLength; j++)
+            captured[j] = CaptureLayout::At(photodiodeData, i, j);
+
+        resampler.Resample(captured, captureLength, stretched, GESTURE_BUFFER_LENGTH);
+
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+            CaptureLayout::At(photodiodeData, i, j) = stretched[j];
+    }
+
+    captureLength = GESTURE_BUFFER_LENGTH;
+}
 
 void GestureDetector::recalibrateThresholds(bool resetTaBuffer)
 {
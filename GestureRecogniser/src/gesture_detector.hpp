@@ -9,19 +9,52 @@
 
 #include "edge_detector.hpp"
 
+#include "util/ring_buffer.hpp"
+#include "util/capture_buffer.hpp"
+
+#include "pre-processing/pipeline/Resampler.h"
+
 // Edge detection parameters
 #define DETECTION_BUFFER_LENGTH 10
 #define DETECTION_WINDOW_LENGTH 5
-#define DETECTION_END_WINDOW_LENGTH 100 //50
+#define DETECTION_END_WINDOW_LENGTH 10
 #define INITIAL_DETECTION_THRESHOLD 100
 #define DETECTION_THRESHOLD_COEFF 0.85f
 #define THRESHOLD_ADJ_BUFFER_LENGTH 100
 
+// End of gesture detection for ADAPTIVE_CAPTURE. A gesture ends when every light sensor has been above
+// DETECTION_END_THRESHOLD_COEFF times its start threshold for DETECTION_END_WINDOW_LENGTH samples,
+// but not before MIN_CAPTURE_LENGTH samples have been captured.
+#define DETECTION_END_THRESHOLD_COEFF 1.1f
+#define MIN_CAPTURE_LENGTH 30
+
+// Number of samples from before the trigger at the start of every captured gesture, taken from the running history.
+// The model was trained on captures that start DETECTION_BUFFER_LENGTH samples before the trigger.
+// The rest of the GESTURE_BUFFER_LENGTH samples is captured after the trigger.
+#define PRE_TRIGGER_LENGTH DETECTION_BUFFER_LENGTH
+
+static_assert(MIN_CAPTURE_LENGTH >= DETECTION_END_WINDOW_LENGTH, "The end of a gesture is detected on captured samples only");
+static_assert(PRE_TRIGGER_LENGTH >= DETECTION_WINDOW_LENGTH && PRE_TRIGGER_LENGTH < GESTURE_BUFFER_LENGTH,
+              "The history must hold the detection window and the capture must include samples after the trigger");
+
+// Streaming auto-gain parameters, judged over every GAIN_MONITOR_WINDOW samples between gestures.
+// The gain is stepped down when a sensor clips in more than MAX_CLIPPED_FRACTION of the samples,
+// and stepped up when no sensor reaches LOW_SIGNAL_READING, so gesture shadows keep enough contrast.
+#define GAIN_MONITOR_WINDOW 50
+#define CLIPPING_READING 1020
+#define MAX_CLIPPED_FRACTION 0.1f
+#define LOW_SIGNAL_READING 150
+
+// Idle sensing parameters. A change of more than IDLE_CHANGE_THRESHOLD between two samples, or a sample below
+// IDLE_ARM_MARGIN times the detection threshold, arms full rate sampling. After IDLE_HOLD_SAMPLES quiet samples
+// at full rate the detector goes back to idle.
+#define IDLE_CHANGE_THRESHOLD 15
+#define IDLE_ARM_MARGIN 1.1f
+#define IDLE_HOLD_SAMPLES 100
+
 // // Minimum duration of a gesture, otherwise it is seen as noise and ignored
 // #define GESTURE_MIN_TIME_MS 100
 
-const uint8_t PHOTO_DIODE_PINS[NUM_LIGHT_SENSORS] = {A0, A1, A2};
-
 /**
  * @brief A class combining multiple EdgeDetectors for multiple light sensors. Together they form a gesture detector.
  *
@@ -29,8 +62,22 @@ const uint8_t PHOTO_DIODE_PINS[NUM_LIGHT_SENSORS] = {A0, A1, A2};
 class GestureDetector
 {
 public:
-    using GestureDetectedCallback = void (*)(uint16_t photodiodeData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH]);
+    using GestureDetectedCallback = void (*)(const CaptureBuffer& photodiodeData);
     using ResetCallback = void (*)();
+    // Called with every sample taken between gestures.
+    using SampleCallback = void (*)(const uint16_t sample[NUM_LIGHT_SENSORS]);
+    // Called with the partially captured gesture at every early prediction checkpoint.
+    // Returning true commits the provisional result and ends the capture, the gestureDetectedCallback is then not called.
+    using EarlyCommitCallback = bool (*)(const CaptureBuffer& photodiodeData, uint16_t length);
+    // Called between gestures when the light sensors should switch one gain step, with GAIN_STEP_UP or GAIN_STEP_DOWN.
+    // Returns the ratio between new and old readings (0 when unknown), or 1 when the gain could not be changed.
+    using GainStepCallback = float (*)(int direction);
+    // Called with every sample that is added to the capture, including the samples before the trigger.
+    // The index is the position of the sample in the capture, 0 starts a new capture.
+    using CaptureSampleCallback = void (*)(const uint16_t sample[NUM_LIGHT_SENSORS], uint16_t index);
+
+    static const int GAIN_STEP_UP = 1;
+    static const int GAIN_STEP_DOWN = -1;
 
 public:
     GestureDetector();
@@ -42,14 +89,28 @@ public:
 
     void setGestureDetectedCallback(GestureDetectedCallback callback) { this->gestureDetectedCallback = callback; } 
     void setResetCallback(ResetCallback callback) { this->resetCallback = callback; }
+    void setEarlyCommitCallback(EarlyCommitCallback callback) { this->earlyCommitCallback = callback; }
+    void setSampleCallback(SampleCallback callback) { this->sampleCallback = callback; }
+    void setGainStepCallback(GainStepCallback callback) { this->gainStepCallback = callback; }
+    void setCaptureSampleCallback(CaptureSampleCallback callback) { this->captureSampleCallback = callback; }
 
     void detectGesture();
 
-    bool detectGestureStart(uint16_t **signals);
-    // bool detectGestureEnd(uint16_t **signals);
+    bool detectGestureStart();
+    bool detectGestureEnd();
 
     void recalibrateThresholds(bool resetTaBuffer = true);
 
+    // Rescales the thresholds and buffered samples after the light sensors changed gain by the given ratio.
+    // A ratio of 0 means the change is unknown, the buffers are then collected again.
+    void applyGainChange(float ratio);
+
+    // Whether only every IDLE_DECIMATION-th call takes a sample
+    bool isIdle() { return idle; }
+
+    // Sampling period in milliseconds, the capture of a gesture reads at this period
+    void setReadPeriod(unsigned long period) { this->readPeriod = period; }
+
     int getThreshold(int i) { return edgeDetectors[i].getThreshold(); }
     void setThreshold(int i, int t) { edgeDetectors[i].setThreshold(t); }
 
@@ -63,20 +124,76 @@ private:
     // This should reset the timer that specifies the sampling time
     ResetCallback resetCallback = nullptr;
 
+    // The early commit callback will be called at every early prediction checkpoint during capture
+    EarlyCommitCallback earlyCommitCallback = nullptr;
+
+    // The sample callback will be called with every sample taken between gestures
+    SampleCallback sampleCallback = nullptr;
+
+    // The gain step callback will be called when the signal clips or is too weak
+    GainStepCallback gainStepCallback = nullptr;
+
+    // The capture sample callback will be called with every sample of a capture
+    CaptureSampleCallback captureSampleCallback = nullptr;
+
+    // Passes the sample at index of the capture to the capture sample callback
+    void feedCaptureSample(uint16_t index);
+
+    bool tryEarlyCommit(uint16_t previousLength);
+
+    // Stretches a capture that ended early over all GESTURE_BUFFER_LENGTH samples
+    void resampleCapture();
+
+    #ifdef POLYPHASE_RESAMPLING
+    Resampler resampler{Resampler::POLYPHASE};
+    #else
+    Resampler resampler{Resampler::LINEAR};
+    #endif // POLYPHASE_RESAMPLING
+
+    // Counts clipped samples and tracks the brightest sample, and requests a gain step at the end of every monitor window
+    void monitorGain(const uint16_t sample[NUM_LIGHT_SENSORS]);
+
+    // Switches between idle and full rate sampling based on the newest sample
+    void updateIdleState(const uint16_t sample[NUM_LIGHT_SENSORS]);
+
+    // Turns the idle rate samples in the history into full rate samples by linear interpolation,
+    // so the edge detection and the captured gesture see the pre-trigger history at the full rate
+    void interpolateHistory();
+
+    // Scales a sample by a gain ratio, rounded and clipped to the range of the ADC
+    static uint16_t rescaleSample(uint16_t sample, float ratio);
+
     // Buffers for dynamic threshold adjustment
     uint16_t thresholdAdjustmentBuffer[NUM_LIGHT_SENSORS][THRESHOLD_ADJ_BUFFER_LENGTH];
     // Pointer to the current index of the thresholdAdjustmentBuffer array for each light sensor
     uint16_t* taBuffer[NUM_LIGHT_SENSORS];
 
+    // Number of samples since the last gesture, up to DETECTION_BUFFER_LENGTH
     int count = 0;
-    bool detectionWindowFull = false;
 
-    // Holds the data from the light sensors
-    uint16_t photodiodeData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH];
+    // Sampling period in milliseconds
+    unsigned long readPeriod = READ_PERIOD;
+
+    // State of the streaming auto-gain
+    uint16_t gainMonitorCount = 0;
+    uint16_t clippedSamples[NUM_LIGHT_SENSORS] = {0};
+    uint16_t gainMonitorPeak = 0;
+
+    // State of the idle sensing, starts at the full rate until the light is known to be quiet
+    bool idle = false;
+    uint8_t idleTicks = 0;
+    uint16_t quietSamples = 0;
+    size_t idleRateSamples = 0;
+    uint16_t previousSample[NUM_LIGHT_SENSORS] = {0};
+
+    // Continuously running history of every light sensor, the start of the next capture
+    RingBuffer<uint16_t, PRE_TRIGGER_LENGTH> history[NUM_LIGHT_SENSORS];
+
+    // Holds the captured gesture of every light sensor, in CaptureLayout
+    CaptureBuffer photodiodeData;
 
-    // Pointer to the current index of the photodiodeData array between 0 and GESTURE_BUFFER_LENGTH. 
-    // One for each light sensor.
-    uint16_t* photodiodeDataPtr[NUM_LIGHT_SENSORS];
+    // Number of samples in photodiodeData during a capture
+    uint16_t captureLength = 0;
 };
 
 #endif // GESTURE_DETECTOR_HPP
\ No newline at end of file
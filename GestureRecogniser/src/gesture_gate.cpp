@@ -0,0 +1,96 @@
+#include "gesture_gate.hpp"
+
+#include <math.h>
+
+GateResult GestureGate::check(const CaptureBuffer& photodiodeData, uint16_t length)
+{
+    bool energetic = false;
+    bool ranged = false;
+    bool stepped = true;
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        // Single pass for the statistics of this light sensor
+        uint32_t sum = 0;
+        uint32_t sumSquares = 0;
+        uint16_t min = UINT16_MAX;
+        uint16_t max = 0;
+        uint16_t saturated = 0;
+
+        for (size_t j = 0; j < length; j++)
+        {
+            uint16_t value = CaptureLayout::At(photodiodeData, i, j);
+            sum += value;
+            sumSquares += (uint32_t) value * value;
+
+            if (value < min)
+                min = value;
+            if (value > max)
+                max = value;
+            if (value >= GATE_SATURATION_LEVEL)
+                saturated++;
+        }
+
+        if (saturated > GATE_MAX_SATURATED_FRACTION * length)
+        {
+            rejected++;
+            return GATE_REJECTED_SATURATED;
+        }
+
+        float mean = (float) sum / length;
+        float variance = (float) sumSquares / length - mean * mean;
+        if (mean > 0 && sqrt(variance) >= GATE_MIN_RELATIVE_ENERGY * mean)
+            energetic = true;
+
+        uint16_t range = max - min;
+        if (max > 0 && range >= GATE_MIN_RELATIVE_RANGE * max)
+            ranged = true;
+
+        // Compare the level before and after the gesture
+        uint32_t startLevel = 0;
+        uint32_t endLevel = 0;
+        for (size_t j = 0; j < GATE_LEVEL_LENGTH; j++)
+        {
+            startLevel += CaptureLayout::At(photodiodeData, i, j);
+            endLevel += CaptureLayout::At(photodiodeData, i, length - 1 - j);
+        }
+
+        float step = fabs((float) startLevel - (float) endLevel) / GATE_LEVEL_LENGTH;
+        if (range == 0 || step <= GATE_MAX_RELATIVE_STEP * range)
+            stepped = false;
+    }
+
+    GateResult result = GATE_ACCEPTED;
+    if (!energetic)
+        result = GATE_REJECTED_LOW_ENERGY;
+    else if (!ranged)
+        result = GATE_REJECTED_FLAT;
+    else if (stepped)
+        result = GATE_REJECTED_STEP;
+
+    if (result == GATE_ACCEPTED)
+        accepted++;
+    else
+        rejected++;
+
+    return result;
+}
+
+const char* gateResultName(GateResult result)
+{
+    switch (result)
+    {
+        case GATE_ACCEPTED:
+            return "accepted";
+        case GATE_REJECTED_SATURATED:
+            return "saturated";
+        case GATE_REJECTED_LOW_ENERGY:
+            return "low energy";
+        case GATE_REJECTED_FLAT:
+            return "flat";
+        case GATE_REJECTED_STEP:
+            return "ambient light change";
+    }
+
+    return "unknown";
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef GESTURE_GATE_HPP
+#define GESTURE_GATE_HPP
+
+#include <stdint.h>
+
+#include "global_constants.hpp"
+
+#include "util/capture_buffer.hpp"
+
+// Gate parameters
+// Readings at or above this value are considered clipped (10-bit ADC)
+#define GATE_SATURATION_LEVEL 1020
+// Maximum fraction of clipped readings on a light sensor before the capture is rejected
+#define GATE_MAX_SATURATED_FRACTION 0.25f
+// Minimum standard deviation relative to the mean on at least one light sensor
+#define GATE_MIN_RELATIVE_ENERGY 0.03f
+// Minimum peak-to-peak amplitude relative to the maximum on at least one light sensor
+#define GATE_MIN_RELATIVE_RANGE 0.1f
+// Maximum difference between the level at the start and at the end of the capture, relative to the peak-to-peak amplitude.
+// A hand leaves again after a gesture, an ambient light change does not.
+#define GATE_MAX_RELATIVE_STEP 0.6f
+// Number of samples averaged for the start and end level
+#define GATE_LEVEL_LENGTH 5
+
+enum GateResult
+{
+    GATE_ACCEPTED,
+    GATE_REJECTED_SATURATED,
+    GATE_REJECTED_LOW_ENERGY,
+    GATE_REJECTED_FLAT,
+    GATE_REJECTED_STEP
+};
+
+/**
+ * @brief A cheap first stage in front of the model. It looks at the raw capture and rejects captures that cannot
+ *        contain a usable gesture (clipped, no movement, or a lasting ambient light change), so no inference is wasted on them.
+ */
+class GestureGate
+{
+public:
+    GestureGate() {}
+
+    GateResult check(const CaptureBuffer& photodiodeData, uint16_t length = GESTURE_BUFFER_LENGTH);
+
+    unsigned long getAccepted() { return accepted; }
+    unsigned long getRejected() { return rejected; }
+
+private:
+    unsigned long accepted = 0;
+    unsigned long rejected = 0;
+};
+
+const char* gateResultName(GateResult result);
+
+#endif // GESTURE_GATE_HPP
\ No newline at end of file
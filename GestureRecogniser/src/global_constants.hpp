@@ -1,12 +1,20 @@
 #ifndef GLOBAL_CONSTANTS_HPP
 #define GLOBAL_CONSTANTS_HPP
 
+#include <Arduino.h>
+
 // Define DEBUG_PRINTS in order to view more information in the serial monitor.
 // #define DEBUG_PRINTS
 
 // Number of OPT101 photodiode sensors used.
 #define NUM_LIGHT_SENSORS 3
 
+// Analog pins the OPT101 photodiode sensors are connected to.
+const uint8_t PHOTO_DIODE_PINS[NUM_LIGHT_SENSORS] = {A0, A1, A2};
+
+// Highest reading of the 10-bit ADC.
+#define ADC_MAX_READING 1023
+
 // Number of datapoints used as input to the model.
 // This is the number of samples taken from each light sensor.
 // And should be the same as the number of inputs used for training the model.
@@ -20,13 +28,120 @@
 // Number of output nodes, which is the number of classes the model can predict.
 #define NUM_FEATURES 10
 
+// Uncomment to classify with a tiny gesture family model followed by a specialist model per family,
+// instead of one model for all gestures. Requires the models exported by export_hierarchical_models in model_constructor.py.
+// #define HIERARCHICAL_MODEL
+
+// Uncomment to use the early exit model, which stops after the first conv block when its auxiliary head is confident enough.
+// Requires the stages exported by export_early_exit_model in model_constructor.py.
+// #define EARLY_EXIT_MODEL
+
+// Minimum score of the auxiliary head of the early exit model to skip the rest of the network.
+#define EARLY_EXIT_THRESHOLD 0.9f
+
 // The length of data buffer storing the photodiode readings.
 #define GESTURE_BUFFER_LENGTH 100
 
 // Sampling period in milliseconds. 10ms -> 100Hz sampling rate. Change to 50 for 20Hz sampling rate.
+// This is the period at boot, it can be changed at runtime with the "r <period> <cutoff>" serial command (ended by a newline).
 #define READ_PERIOD 10
 
-// // Time between recalibration in milliseconds. Sets up a new LightIntensityRegulator every X ms. (not used)
-// #define RECALIBRATE_PERIOD 5000
+// Cutoff frequency in Hz of the low pass filter in the pre-processing, the filter is designed for the sampling rate on the device.
+#define LOW_PASS_CUTOFF 25.0f
+
+// Sleep between the ticks of the sampling timer instead of busy waiting in loop().
+// Comment out LOW_POWER_IDLE to spin on the timers.
+#define LOW_POWER_IDLE
+
+// Uncomment to print the active and idle time per tick every DUTY_CYCLE_REPORT_PERIOD milliseconds.
+// #define REPORT_DUTY_CYCLE
+#define DUTY_CYCLE_REPORT_PERIOD 10000
+
+// Idle sensing. Without activity the GestureDetector only samples every IDLE_DECIMATION-th READ_PERIOD (20 Hz),
+// and switches to the full sampling rate as soon as a sample suggests motion. The pre-trigger samples of the next capture
+// are then interpolated, the idle sensing replay in Model/replay reports how much that costs in accuracy.
+// Comment out IDLE_SENSING to always sample at the full rate.
+#define IDLE_SENSING
+#define IDLE_DECIMATION 5
+
+// Adaptive length capture. The capture ends as soon as the end of the gesture is detected, instead of always taking
+// GESTURE_BUFFER_LENGTH samples, and is then stretched to GESTURE_BUFFER_LENGTH samples for the model.
+// The model should be trained on stretched captures, see evaluate_adaptive_capture in Model/replay_harness.py.
+// #define ADAPTIVE_CAPTURE
+
+// Captures are resampled with linear interpolation (adaptive capture, or GESTURE_BUFFER_LENGTH != NUM_DATAPOINTS).
+// Uncomment to use a windowed sinc (polyphase) filter instead, which is smoother but about TAPS / 2 times slower.
+// #define POLYPHASE_RESAMPLING
+
+// Pre-process the samples of a capture while they are acquired, so only a rescale pass is left after the capture.
+// Comment out STREAMING_PREPROCESSING to run the whole pre-processing pipeline after the capture.
+#define STREAMING_PREPROCESSING
+
+// Normalise and standardise captures with one multiply-add per sample instead of divides.
+// Comment out FAST_MATH_PREPROCESSING to run the reference pre-processing step by step.
+#define FAST_MATH_PREPROCESSING
+
+// The pre-processing loops use the DSP instructions of the Cortex-M4 (SSE2 when the code is built on a PC).
+// Uncomment to use the plain loops instead.
+// #define SCALAR_KERNELS
+
+// Captures are stored per light sensor ([sensor][time]), and transposed into the time major order of the model input.
+// Uncomment to store them interleaved ([time][sensor]) from the acquisition up to the model input instead, which makes
+// the model input a straight copy of the pre-processed capture. The statistics of interleaved captures take the plain
+// loop on the Cortex-M4, BENCHMARK_PREPROCESSING times both layouts.
+// #define INTERLEAVED_CAPTURES
+
+// Uncomment to time the reference and the fast pre-processing at boot and print how far apart their outputs are.
+// Also times the resampler on captures of adaptive length.
+// #define BENCHMARK_PREPROCESSING
+#define BENCHMARK_PREPROCESSING_RUNS 100
+
+// Longest line of a serial command, see handleSerialCommands in main.cpp.
+#define SERIAL_COMMAND_LENGTH 32
+
+// Early (anytime) prediction. During capture a provisional inference is made on the partial window
+// after each of these numbers of samples. The missing part of the window is padded with the last sample.
+// The samples the capture misses while the inference runs are filled in by linear interpolation.
+// Comment out EARLY_PREDICTION to always wait for the full GESTURE_BUFFER_LENGTH samples.
+#define EARLY_PREDICTION
+#define EARLY_PREDICTION_CHECKPOINTS {40, 60, 80}
+#define NUM_EARLY_PREDICTION_CHECKPOINTS 3
+
+// Minimum difference between the highest and the second highest class score
+// before a provisional prediction is committed and the capture is ended early.
+#define EARLY_COMMIT_MARGIN 0.6f
+
+// Cheap first stage that rejects captures that cannot contain a gesture before running the model on them.
+// Comment out GESTURE_GATE to pass every capture to the model.
+#define GESTURE_GATE
+
+// Continuous inference. Instead of waiting for an edge trigger, overlapping windows are classified every hop samples.
+// Uncomment CONTINUOUS_INFERENCE to use the ContinuousDetector instead of the GestureDetector.
+// #define CONTINUOUS_INFERENCE
+
+// Smallest number of samples between two classified windows.
+#define CONTINUOUS_MIN_HOP 10
+
+// Fraction of the time that may be spent on inference in continuous mode, the hop size is chosen to stay below it.
+#define CONTINUOUS_DUTY_CYCLE_BUDGET 0.5f
+
+// Minimum score of the predicted class in continuous mode. Windows with a lower score are treated as "no gesture".
+#define CONTINUOUS_SCORE_GATE 0.9f
+
+// Time between recalibrations of the light sensors in milliseconds. Runs in the background on the sampled data.
+#define RECALIBRATE_PERIOD 30000
+
+// Keep the calibration, thresholds and model selection in flash, so they can be restored at the next boot
+// instead of waiting for a full calibration. Comment out PERSIST_CALIBRATION to always calibrate at boot.
+#define PERSIST_CALIBRATION
+
+// Time between checks whether the stored calibration is outdated, in milliseconds.
+#define CALIBRATION_STORE_PERIOD 600000
+
+// Time after a cold boot before the first calibration is stored, long enough to learn the detection thresholds.
+#define CALIBRATION_FIRST_STORE_DELAY 5000
+
+// Relative change of a detection threshold before the stored calibration is rewritten, limits the flash wear.
+#define CALIBRATION_STORE_TOLERANCE 0.2f
 
 #endif // GLOBAL_CONSTANTS_HPP
\ No newline at end of file
@@ -10,24 +10,49 @@
 
 #include "util/led_control.hpp"
 
-// Resistor comparator function for sorting in decreasing order.
-bool comparator(Resistor const &a, Resistor const &b)
+// Constructor, uses the resistors and their power set defined in the header.
+// The sensors are not calibrated yet, call calibrateSensors or restoreCalibration.
+LightIntensityRegulator::LightIntensityRegulator()
 {
-	return a.value > b.value;
+	this->resistor_index = 0;
+
+	// The output voltage of the OPT101 is proportional to the feedback resistance, so that is the initial gain model
+	for (int i = 0; i < POWER_SET_SIZE; i++)
+		gains[i] = powerSet.values[i];
 }
 
-// Constructor with parameters for resistors (defaults to "resisistors" defined above). Number of resistors (size) is also required (default is 4).
-LightIntensityRegulator::LightIntensityRegulator(const Resistor *resistors, int size)
+void LightIntensityRegulator::restoreCalibration(int index, const float restoredGains[POWER_SET_SIZE])
 {
-	this->resistor_index = 0;
+	memcpy(gains, restoredGains, sizeof(gains));
+
+	this->resistor_index = index;
+	set_resistor(powerSet.masks[index]);
+}
+
+// A single sweep is enough to tell whether the light changed so much that the stored resistor no longer fits,
+// the background calibration takes care of smaller changes.
+bool LightIntensityRegulator::verifyCalibration()
+{
+	// restoreCalibration just switched the resistor
+	delay(GAIN_SETTLE_PERIOD);
+
+	int brightest = 0;
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+	{
+		calibration_readings[i] = analogRead(PHOTO_DIODE_PINS[i]);
 
-	// Create powerset and sort
-	this->size = pow(2, size);
-	this->powerSet = this->createPowerSet(resistors, this->size);
+		if (calibration_readings[i] > brightest)
+			brightest = calibration_readings[i];
+	}
 
-	std::sort(powerSet.begin(), powerSet.end(), &comparator);
+	// Too bright or too dark can't be fixed when the resistor is already the lowest or highest one
+	bool tooBright = brightest > MAXIMUM_THRESHOLD * (1 + RESTORE_TOLERANCE) && this->resistor_index < POWER_SET_SIZE - 1;
+	bool tooDark = brightest < MINIMUM_THRESHOLD * (1 - RESTORE_TOLERANCE) && this->resistor_index > 0;
+	if (tooBright || tooDark)
+		return false;
 
-	this->calibrateSensors();
+	updateOutcomes(true);
+	return true;
 }
 
 void LightIntensityRegulator::calibrateSensors()
@@ -36,55 +61,265 @@ void LightIntensityRegulator::calibrateSensors()
 	Serial.println("Calibrating sensors...");
 	#endif
 
-	set_resistor(powerSet[0].pins);
+	set_resistor(powerSet.masks[0]);
 
 	// Allow the capacitor to charge up
 	delay(100);
 
-	int reading = this->get_reading();
+	// All sensors are read in the same sweep, so the search takes at most log2(size) sweeps regardless of the number of sensors.
+	// A step of the search can change the resistance by orders of magnitude, so every sweep waits for the output to settle.
+	int index = bisectPowerSet([this](int i, int readings[NUM_LIGHT_SENSORS]) {
+		this->resistor_index = i;
+		set_resistor(powerSet.masks[i]);
+		delay(GAIN_SETTLE_PERIOD);
+		return this->get_readings(readings);
+	}, MAXIMUM_THRESHOLD, calibration_readings);
+
+	this->resistor_index = index;
+	set_resistor(powerSet.masks[index]);
+
+	updateOutcomes(true);
+
+	#ifdef DEBUG_PRINTS
+	Serial.println("Calibration done!");
+	#endif
+}
 
-	// Loop trough available resistors until the value drops enough
-	while (reading > MAXIMUM_THRESHOLD)
+// Classifies the calibration readings of every sensor, reports them over serial and optionally summarises them on the LED.
+void LightIntensityRegulator::updateOutcomes(bool showOnLed)
+{
+	// A higher resistor would push the brightest sensor above MAXIMUM_THRESHOLD, so sensors that are still
+	// too dark can't be fixed with the shared resistor bank. They are reported per sensor instead.
+	bool resistorFound = true;
+	bool allOk = true;
+	bool allTooDark = true;
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
 	{
-		if (!this->resistorDown())
-		{
-			// Required resistor does not exist, set red LED
-			setLedColour(RED);
-			return;
-		}
+		if (calibration_readings[i] > MAXIMUM_THRESHOLD)
+			outcomes[i] = CALIBRATION_TOO_BRIGHT;
+		else if (calibration_readings[i] < MINIMUM_THRESHOLD)
+			outcomes[i] = CALIBRATION_TOO_DARK;
 		else
-		{
-			// Get new reading
-			reading = this->get_reading();
-		}
+			outcomes[i] = CALIBRATION_OK;
+
+		if (outcomes[i] == CALIBRATION_TOO_BRIGHT)
+			resistorFound = false;
+		if (outcomes[i] != CALIBRATION_OK)
+			allOk = false;
+		if (outcomes[i] != CALIBRATION_TOO_DARK)
+			allTooDark = false;
+	}
+
+	// Even the highest resistor is not enough
+	if (allTooDark && this->resistor_index == 0)
+		resistorFound = false;
+
+	if (!showOnLed)
+	{
+		// Leave the LED to the gesture detector
+	}
+	else if (!resistorFound)
+	{
+		// Required resistor does not exist, set red LED
+		setLedColour(RED);
+	}
+	else if (!allOk)
+	{
+		// System maybe configured correctly, set blue LED
+		setLedColour(BLUE);
+	}
+	else
+	{
+		// System configured correctly, set green LED
+		setLedColour(GREEN);
+	}
+
+	reportOutcomes();
+}
+
+void LightIntensityRegulator::reportOutcomes()
+{
+	static const char* outcomeNames[] = {"ok", "too dark", "too bright"};
+
+	Serial.print("Calibrated resistance ");
+	Serial.print(powerSet.values[this->resistor_index]);
+	Serial.print(" Ohm.");
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+	{
+		Serial.print(" Sensor ");
+		Serial.print(i);
+		Serial.print(": ");
+		Serial.print(calibration_readings[i]);
+		Serial.print(" (");
+		Serial.print(outcomeNames[outcomes[i]]);
+		Serial.print(")");
+	}
+	Serial.println();
+}
+
+void LightIntensityRegulator::startBackgroundCalibration()
+{
+	background_active = true;
+	background_count = 0;
+	stable_windows = 0;
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+		background_sums[i] = 0;
+}
+
+// Accumulates the samples of the gesture detector in windows. Once the readings have been steady for BACKGROUND_STABLE_WINDOWS
+// windows at the current resistor, the readings at every other resistor are predicted with the gain model and the best resistor
+// is chosen without having to try it. The first steady readings after a gain change are used to refine the gain model first.
+void LightIntensityRegulator::feedSamples(const uint16_t sample[NUM_LIGHT_SENSORS])
+{
+	if (!background_active && !verifying_gain)
+		return;
+
+	// The readings are still moving towards the new gain right after a switch
+	if (millis() - gain_switch_time < GAIN_SETTLE_PERIOD)
+		return;
+
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+		background_sums[i] += sample[i];
+
+	if (++background_count < window)
+		return;
+
+	int readings[NUM_LIGHT_SENSORS];
+	int brightest = 0;
+	bool stable = true;
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+	{
+		readings[i] = background_sums[i] / window;
+		background_sums[i] = 0;
+
+		if (readings[i] > brightest)
+			brightest = readings[i];
+
+		if (abs(readings[i] - last_window_readings[i]) > last_window_readings[i] * BACKGROUND_STABILITY + 2)
+			stable = false;
+	}
+	background_count = 0;
+	memcpy(last_window_readings, readings, sizeof(readings));
+
+	// A single window can be darkened by a passing hand, which would bias the gain and switch it in the middle of a gesture
+	stable_windows = stable ? stable_windows + 1 : 1;
+	if (stable_windows < BACKGROUND_STABLE_WINDOWS)
+		return;
+
+	if (verifying_gain)
+	{
+		refineGainModel(readings);
+		verifying_gain = false;
 	}
 
-	// Reading is now low enough for accurate sensing.
-	if (reading < MINIMUM_THRESHOLD)
+	if (!background_active)
+		return;
+
+	memcpy(calibration_readings, readings, sizeof(readings));
+	memcpy(readings_before_change, readings, sizeof(readings));
+
+	float current = gains[this->resistor_index];
+
+	// A clipped reading can't be extrapolated, and a zero resistance gives no reading to extrapolate from.
+	// Take one step in the right direction and measure again.
+	if (brightest >= SATURATION_READING)
 	{
-		if (!this->resistorUp())
+		if (this->resistor_index + 1 < POWER_SET_SIZE)
 		{
-			// Required resistor does not exist, set red LED
-			setLedColour(RED);
+			pending_index = this->resistor_index + 1;
+			return;
 		}
-		else
+	}
+	else if (current == 0)
+	{
+		pending_index = this->resistor_index - 1;
+		return;
+	}
+	else
+	{
+		// Highest resistance at which the brightest sensor is predicted to stay below MAXIMUM_THRESHOLD
+		int target = POWER_SET_SIZE - 1;
+		for (int i = 0; i < POWER_SET_SIZE; i++)
 		{
-			// System maybe configured correctly, set blue LED
-			setLedColour(BLUE);
+			if (brightest * gains[i] / current <= MAXIMUM_THRESHOLD)
+			{
+				target = i;
+				break;
+			}
 		}
+
+		for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+			calibration_readings[i] = calibration_readings[i] * gains[target] / current;
+
+		if (target != this->resistor_index)
+			pending_index = target;
 	}
-	else
+
+	background_active = false;
+	updateOutcomes(false);
+}
+
+// Compares the readings after a gain change, once the output settled, with the readings before it, and moves the gain of
+// the new resistor towards the measured ratio. Only sensors that are neither clipped nor dark in both measurements are used.
+void LightIntensityRegulator::refineGainModel(const int readings[NUM_LIGHT_SENSORS])
+{
+	int before = 0;
+	int after = 0;
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
 	{
-		// System configured correctly, set green LED
-		setLedColour(GREEN);
+		if (readings_before_change[i] > 0 && readings_before_change[i] < SATURATION_READING &&
+			readings[i] > 0 && readings[i] < SATURATION_READING)
+		{
+			before += readings_before_change[i];
+			after += readings[i];
+		}
 	}
 
-	#ifdef DEBUG_PRINTS
-	Serial.println("Calibration done!");
-	#endif
+	if (before == 0 || after == 0 || gains[previous_index] == 0)
+		return;
+
+	float measured = gains[previous_index] * after / before;
+	gains[this->resistor_index] += GAIN_MODEL_LEARNING_RATE * (measured - gains[this->resistor_index]);
+}
+
+// Switches to the resistor chosen by the background calibration.
+// Returns the expected change of every reading according to the gain model.
+// Returns 0 when the change can't be predicted, because the old gain was zero.
+float LightIntensityRegulator::applyPendingGainChange()
+{
+	if (pending_index < 0)
+		return 1;
+
+	float ratio = switchGain(pending_index);
+
+	// The readings before the change are known from the background calibration, so the change can be measured
+	verifying_gain = true;
+
+	return ratio;
+}
+
+float LightIntensityRegulator::switchGain(int index)
+{
+	previous_index = this->resistor_index;
+
+	this->resistor_index = index;
+	set_resistor(powerSet.masks[index]);
+	gain_switch_time = millis();
+
+	// A pending change was chosen for the old resistor, and samples taken with it can't be mixed with the new ones.
+	// A running background calibration continues on the samples at the new gain.
+	pending_index = -1;
+	verifying_gain = false;
+	background_count = 0;
+	stable_windows = 0;
+	for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+		background_sums[i] = 0;
+
+	last_gain_ratio = gains[previous_index] == 0 ? 0 : gains[index] / gains[previous_index];
+	return last_gain_ratio;
 }
 
-// Use a resistor that is higher than the current value. Voltage output of the OPT101, and thus the received value, will go down.
+// Use a resistor that is higher than the current value. Voltage output of the OPT101, and thus the received value, will go up.
 // Returns true on success, false when the active resistor was already the highest possible.
 bool LightIntensityRegulator::resistorUp()
 {
@@ -95,8 +330,7 @@ bool LightIntensityRegulator::resistorUp()
 		return false;
 	}
 
-	this->resistor_index--;
-	set_resistor(this->powerSet[this->resistor_index].pins);
+	switchGain(index);
 	
 	return true;
 }
@@ -107,92 +341,67 @@ bool LightIntensityRegulator::resistorDown()
 {
 	int index = this->resistor_index + 1;
 
-	if (index >= this->size)
+	if (index >= POWER_SET_SIZE)
 	{
 		// Index is not possible
 		return false;
 	}
 	
-	this->resistor_index++;
-	set_resistor(this->powerSet[this->resistor_index].pins);
+	switchGain(index);
 	
 	return true;
 }
 
 
-// Create a powerSet of all available resistors.
-std::vector<Resistor> LightIntensityRegulator::createPowerSet(const Resistor *set, int size)
-{
-	std::vector<Resistor> powerSet(size);
-
-	// Fill powerset
-	for (int counter = 0; counter < size; counter++)
-	{
-		std::vector<uint8_t> pin_numbers;
-		std::vector<float> values;
-
-		for (int j = 0; j < size; j++)
-		{
-			if (counter & (1 << j))
-			{
-				values.push_back(set[j].value);
-				pin_numbers.push_back(set[j].pins.at(0)); // Since these are single resistors the pin numbers are at postion 0.
-			}
-		}
-		powerSet[counter] = Resistor{pin_numbers, calculate_total_resistance_series(values)};
-	}
-	return powerSet;
-}
-
-// Set a list of resistors.
-void LightIntensityRegulator::set_resistor(const std::vector<uint8_t> indices)
+// Switch on the resistors in the mask and switch off all others. A resistor is switched on by pulling its pin low.
+// The pins are written together with the OUTSET and OUTCLR registers of their GPIO port, instead of one digitalWrite each.
+// The resistor pins are spread over both ports of the nRF52840, so the switch still takes up to four register writes.
+// Those follow each other within a few clock cycles, far faster than the OPT101 can respond to the combinations in between.
+void LightIntensityRegulator::set_resistor(uint8_t mask)
 {
-	// First unset all resistors
-
-	for (uint8_t i = 0; i < sizeof(resistors) / sizeof(Resistor); i++)
-	{
-		digitalWrite(resistors[i].pins.at(0), HIGH);
-	}
-
-	// Then set all resistors
-	for (unsigned int j = 0; j < indices.size(); j++)
+	#ifdef NRF_P1
+	uint32_t set[2] = {0, 0};
+	uint32_t clear[2] = {0, 0};
+	for (uint8_t i = 0; i < NUM_RESISTORS; i++)
 	{
-		digitalWrite(indices.at(j), LOW);
+		// Pin names number the pins of P0 from 0 and those of P1 from 32
+		uint32_t pin = digitalPinToPinName(resistors[i].pin);
+		uint32_t bit = 1UL << (pin & 31);
+		if (mask & (1 << i))
+			clear[pin >> 5] |= bit;
+		else
+			set[pin >> 5] |= bit;
 	}
-}
 
-// Calculates the total resistive value of a set of resistors.
-// 1/Rtot = 1/R1 + 1/R2 ...
-float LightIntensityRegulator::calculate_total_resistance_parallel(std::vector<float> values)
-{
-	float sum = 0;
-	for (unsigned int i = 0; i < values.size(); i++)
+	NRF_P0->OUTSET = set[0];
+	NRF_P0->OUTCLR = clear[0];
+	NRF_P1->OUTSET = set[1];
+	NRF_P1->OUTCLR = clear[1];
+	#else
+	// Pin by pin where the GPIO registers are not available
+	for (uint8_t i = 0; i < NUM_RESISTORS; i++)
 	{
-		sum += 1 / values.at(i);
+		digitalWrite(resistors[i].pin, (mask & (1 << i)) ? LOW : HIGH);
 	}
-	return 1 / sum;
+	#endif // NRF_P1
 }
 
-// Adds all resistances toghether to get the resistance in series.
-float LightIntensityRegulator::calculate_total_resistance_series(std::vector<float> values)
+int LightIntensityRegulator::get_readings(int readings[NUM_LIGHT_SENSORS])
 {
-	float sum = 0;
-	for (unsigned int i = 0; i < values.size(); i++)
+	int read_sums[NUM_LIGHT_SENSORS] = {0};
+	for (int i = 0; i < window; i++)
 	{
-		sum += values.at(i);
+		for (int j = 0; j < NUM_LIGHT_SENSORS; j++)
+			read_sums[j] += analogRead(PHOTO_DIODE_PINS[j]);
+		delay(delay_period);
 	}
-	return sum;
-}
 
-int LightIntensityRegulator::get_reading()
-{
-	delay(10);
-
-	int read_sum = 0;
-	for (int i = 0; i < window; i++)
+	int highest = 0;
+	for (int j = 0; j < NUM_LIGHT_SENSORS; j++)
 	{
-		read_sum += analogRead(diode);
-		delay(delay_period);
+		readings[j] = read_sums[j] / window;
+		if (readings[j] > highest)
+			highest = readings[j];
 	}
-	return read_sum / window;
+	return highest;
 }
\ No newline at end of file
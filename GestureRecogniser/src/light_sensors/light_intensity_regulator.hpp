@@ -10,27 +10,155 @@
 #define LIGHT_INTENSITY_REGULATOR_HPP
 
 #include "Arduino.h"
-#include <vector>
-#include <algorithm>
 
-// Resistor struct. Pins determine which pins should be on, value represents the resistive value that is then reached.
+#include "global_constants.hpp"
+
+// Resistor struct. Pin determines which pin switches the resistor on, value represents its resistive value.
 struct Resistor
 {
-	std::vector<uint8_t> pins;
+	uint8_t pin;
 	float value;
 };
 
 // Set available resistor values.
-const Resistor resistors[] = {{{D12}, 660000}, {{D11}, 330000}, {{D10}, 100000}, {{D9}, 22000}};
+#define NUM_RESISTORS 4
+constexpr Resistor resistors[NUM_RESISTORS] = {{D12, 660000}, {D11, 330000}, {D10, 100000}, {D9, 22000}};
+
+// Every combination of resistors, represented as a bitmask over the resistors array.
+#define POWER_SET_SIZE (1 << NUM_RESISTORS)
+
+// Adds all resistances of the resistors in the mask toghether to get the resistance in series.
+constexpr float calculate_total_resistance_series(uint8_t mask)
+{
+	float sum = 0;
+	for (uint8_t i = 0; i < NUM_RESISTORS; i++)
+	{
+		if (mask & (1 << i))
+			sum += resistors[i].value;
+	}
+	return sum;
+}
+
+// Calculates the total resistive value of the resistors in the mask in parallel.
+// 1/Rtot = 1/R1 + 1/R2 ...
+constexpr float calculate_total_resistance_parallel(uint8_t mask)
+{
+	float sum = 0;
+	for (uint8_t i = 0; i < NUM_RESISTORS; i++)
+	{
+		if (mask & (1 << i))
+			sum += 1 / resistors[i].value;
+	}
+	return sum == 0 ? 0 : 1 / sum;
+}
+
+// The power set of all resistors, sorted by decreasing total resistance.
+struct PowerSet
+{
+	uint8_t masks[POWER_SET_SIZE];
+	float values[POWER_SET_SIZE];
+};
+
+// Builds the sorted power set. Evaluated by the compiler, so no sorting or allocation happens on the device.
+constexpr PowerSet createPowerSet()
+{
+	PowerSet powerSet = {};
+	for (uint8_t mask = 0; mask < POWER_SET_SIZE; mask++)
+	{
+		powerSet.masks[mask] = mask;
+		powerSet.values[mask] = calculate_total_resistance_series(mask);
+	}
+
+	// Insertion sort in decreasing order of resistance
+	for (int i = 1; i < POWER_SET_SIZE; i++)
+	{
+		uint8_t mask = powerSet.masks[i];
+		float value = powerSet.values[i];
+
+		int j = i - 1;
+		while (j >= 0 && powerSet.values[j] < value)
+		{
+			powerSet.masks[j + 1] = powerSet.masks[j];
+			powerSet.values[j + 1] = powerSet.values[j];
+			j--;
+		}
+
+		powerSet.masks[j + 1] = mask;
+		powerSet.values[j + 1] = value;
+	}
+
+	return powerSet;
+}
+
+constexpr PowerSet powerSet = createPowerSet();
+
+static_assert(powerSet.values[0] == calculate_total_resistance_series(POWER_SET_SIZE - 1), "Power set is not sorted by decreasing resistance");
+static_assert(powerSet.values[POWER_SET_SIZE - 1] == 0, "Power set is not sorted by decreasing resistance");
+
+// Bisects the power set for the lowest index (highest resistance) at which no sensor reads above maximum, and returns it.
+// readAt(index, readings) switches to an entry of the power set, reads every light sensor in the same sweep and returns the
+// highest reading. The readings at the returned index are written to readings. Takes at most log2(POWER_SET_SIZE) sweeps.
+template <typename ReadFunction>
+int bisectPowerSet(ReadFunction readAt, int maximum, int readings[NUM_LIGHT_SENSORS])
+{
+	// The power set is sorted by decreasing resistance, so the readings decrease with the index
+	int low = 0;
+	int high = POWER_SET_SIZE - 1;
+	int sweep[NUM_LIGHT_SENSORS];
+	bool highRead = false;
+	bool lowNeighbourRead = false;
+	int lowNeighbourReadings[NUM_LIGHT_SENSORS];
+
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+
+		if (readAt(middle, sweep) > maximum)
+		{
+			low = middle + 1;
+			lowNeighbourRead = true;
+			memcpy(lowNeighbourReadings, sweep, sizeof(sweep));
+		}
+		else
+		{
+			high = middle;
+			highRead = true;
+			memcpy(readings, sweep, sizeof(sweep));
+		}
+	}
+
+	// The result has been read, unless it is the fallback (last) index. In that case the readings are predicted from the
+	// readings of its neighbour, as the output voltage of the OPT101 is proportional to the feedback resistance.
+	// The neighbour can't be the 0 Ohm entry, as that is the last one, but a zero resistance gives nothing to scale from.
+	if (!highRead)
+	{
+		if (lowNeighbourRead && powerSet.values[low - 1] > 0)
+		{
+			for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+				readings[i] = lowNeighbourReadings[i] * powerSet.values[low] / powerSet.values[low - 1];
+		}
+		else
+		{
+			readAt(low, readings);
+		}
+	}
+
+	return low;
+}
+
+// Outcome of the calibration for a single light sensor.
+enum CalibrationOutcome
+{
+	CALIBRATION_OK,
+	CALIBRATION_TOO_DARK,
+	CALIBRATION_TOO_BRIGHT
+};
 
 // Class that handles resistor configuration.
 class LightIntensityRegulator
 {
 public:
 
-	// Set diode to finetune
-	const uint8_t diode = A0;
-
 	// Parameters for diode calibration.
 	const int window = 10;
 	const int delay_period = 10;
@@ -39,13 +167,63 @@ public:
 	const int MINIMUM_THRESHOLD = 350;
 	const int MAXIMUM_THRESHOLD = 750;
 
+	// Readings at or above this value are clipped by the 10-bit ADC
+	const int SATURATION_READING = 1020;
+
+	// Time in ms the OPT101 output needs to settle after a resistor switch, samples taken before that are not used
+	const unsigned long GAIN_SETTLE_PERIOD = 100;
+
+	// The background calibration only decides, and the gain model is only refined, once this many windows in a row
+	// have readings within BACKGROUND_STABILITY (relative, plus 2 ADC steps) of the window before them.
+	// A hand or shadow passing over the sensors changes the readings for less than that.
+	const int BACKGROUND_STABLE_WINDOWS = 5;
+	const float BACKGROUND_STABILITY = 0.05f;
+
+	// How far the gain model moves towards a measured gain ratio after a gain change
+	const float GAIN_MODEL_LEARNING_RATE = 0.5f;
+
+	// How far the brightest reading may be outside the thresholds before a restored calibration is rejected
+	const float RESTORE_TOLERANCE = 0.25f;
+
 public:
-	// Constructor with parameters for resistors (defaults to "resisistors" defined above). Number of resistors (size) is also required (default is 4).
-	LightIntensityRegulator(const Resistor *resistors = resistors, int size = 4);
+	// Constructor, uses the resistors and their power set defined above.
+	// Doesn't calibrate the sensors, see calibrateSensors and restoreCalibration.
+	LightIntensityRegulator();
 
+	// Calibrates all light sensors in the same ADC sweep. The sensors share one resistor bank, so the highest resistance
+	// that keeps every sensor below MAXIMUM_THRESHOLD is chosen and the outcome is reported per sensor.
 	void calibrateSensors();
 
-	// Use a resistor that is higher than the current value. Voltage output of the OPT101, and thus the received value, will go down.
+	// Switches to a resistor and gain model that were stored earlier, instead of calibrating.
+	void restoreCalibration(int index, const float restoredGains[POWER_SET_SIZE]);
+
+	// Checks a restored calibration with a single reading of every light sensor, see getCalibrationReading.
+	// Returns false when the light changed so much that the sensors should be calibrated again.
+	bool verifyCalibration();
+
+	// Starts a calibration that runs in the background on the samples of the gesture detector, instead of taking its own readings.
+	// The resistor is not switched by the calibration itself, see applyPendingGainChange.
+	void startBackgroundCalibration();
+	bool isBackgroundCalibrationActive() { return background_active; }
+
+	// Feeds one sample of every light sensor to the background calibration.
+	void feedSamples(const uint16_t sample[NUM_LIGHT_SENSORS]);
+
+	// Whether the background calibration wants to switch resistors. Should only be applied between gestures.
+	bool hasPendingGainChange() { return pending_index >= 0; }
+
+	// Switches to the resistor chosen by the background calibration and returns the expected ratio between new and old
+	// readings (0 when it is unknown), which can be used to rescale thresholds and buffered samples.
+	float applyPendingGainChange();
+
+	// Gain model: the relative sensitivity of every entry of the power set, refined after every gain change
+	float getGain(int index) { return gains[index]; }
+	int getResistorIndex() { return resistor_index; }
+
+	CalibrationOutcome getOutcome(int sensor) { return outcomes[sensor]; }
+	int getCalibrationReading(int sensor) { return calibration_readings[sensor]; }
+
+	// Use a resistor that is higher than the current value. Voltage output of the OPT101, and thus the received value, will go up.
 	// Returns true on success, false when the active resistor was already the highest possible.
 	bool resistorUp();
 
@@ -53,27 +231,50 @@ public:
 	// Returns true on success, false when the active resistor was already the lowest possible.
 	bool resistorDown();
 
+	// Expected ratio between new and old readings of the last resistor switch, 0 when it is unknown
+	float getLastGainRatio() { return last_gain_ratio; }
+
 private:
 	int resistor_index;
-	int size;
-	std::vector<Resistor> powerSet;
 
-private:
+	// Reading and outcome of every light sensor at the chosen resistor
+	int calibration_readings[NUM_LIGHT_SENSORS];
+	CalibrationOutcome outcomes[NUM_LIGHT_SENSORS];
 
-	// Create a powerSet of all available resistors.
-	std::vector<Resistor> createPowerSet(const Resistor *set, int size);
+	// State of the background calibration
+	bool background_active = false;
+	int background_count = 0;
+	uint32_t background_sums[NUM_LIGHT_SENSORS];
+	int pending_index = -1;
+
+	// Readings of the last window, and the number of windows in a row with readings close to the window before them
+	int last_window_readings[NUM_LIGHT_SENSORS] = {0};
+	int stable_windows = 0;
+
+	// Gain model, initialised from the resistances and refined from measurements
+	float gains[POWER_SET_SIZE];
+
+	// State of the gain model refinement after a gain change
+	bool verifying_gain = false;
+	int previous_index = 0;
+	int readings_before_change[NUM_LIGHT_SENSORS] = {0};
+	float last_gain_ratio = 1;
+	unsigned long gain_switch_time = 0;
+
+private:
 
-	// Set a list of resistors.
-	void set_resistor(const std::vector<uint8_t> indices);
+	// Switch on the resistors in the mask and switch off all others.
+	void set_resistor(uint8_t mask);
 
-	// Calculates the total resistive value of a set of resistors.
-	// 1/Rtot = 1/R1 + 1/R2 ...
-	float calculate_total_resistance_parallel(std::vector<float> values);
+	// Reads all light sensors in the same sweep and averages over the window. Returns the highest reading.
+	int get_readings(int readings[NUM_LIGHT_SENSORS]);
 
-	// Adds all resistances toghether to get the resistance in series.
-	float calculate_total_resistance_series(std::vector<float> values);
+	void updateOutcomes(bool showOnLed);
 
-	int get_reading();
+	// Switches to the given entry of the power set and returns the expected ratio between new and old readings
+	float switchGain(int index);
+	void refineGainModel(const int readings[NUM_LIGHT_SENSORS]);
+	void reportOutcomes();
 };
 
 #endif // LIGHT_INTENSITY_REGULATOR_HPP
\ No newline at end of file
@@ -9,20 +9,47 @@
 
 #include "light_sensors/light_intensity_regulator.hpp"
 #include "gesture_detector.hpp"
+#include "continuous_detector.hpp"
+#include "gesture_gate.hpp"
 
 #include "util/led_control.hpp"
+#include "util/calibration_store.hpp"
+#include "util/tick_scheduler.hpp"
 
 ModelWrapper* modelWrapper;
 LightIntensityRegulator* lightIntensityRegulator;
 GestureDetector* gestureDetector;
+ContinuousDetector* continuousDetector;
+GestureGate gestureGate;
 
 // Timers for managing sample rate and recalibrating the sensitivity of the light sensors periodically.
 SimpleTimer timer;
 int sampleTimerID;
-// int recalibrateTimerID;
+int recalibrateTimerID;
+
+// Sampling period in milliseconds and cutoff of the low pass filter, can be changed at runtime with configureSampling
+unsigned long samplePeriod = READ_PERIOD;
+float lowPassCutoff = LOW_PASS_CUTOFF;
+SimpleTimer::timer_callback sampleTimerCallback;
+
+// Sleeps between the ticks of the sampling timer
+TickScheduler tickScheduler(READ_PERIOD);
+
+// Calibration that was loaded from flash at boot, or stored last
+CalibrationRecord calibrationRecord = {};
+bool calibrationRecordLoaded = false;
+
+// Whether the loaded calibration was still valid, in which case the full calibration at boot is skipped
+bool calibrationRestored = false;
+
+// Set by the store timers, the flash is written from loop() once it can't delay a gesture
+bool calibrationStorePending = false;
 
 // GestureDetector::GestureDetectedCallback gestureDetectedCallback;
-void gestureDetectedCallback(uint16_t photodiodeData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH]);
+void gestureDetectedCallback(const CaptureBuffer& photodiodeData);
+bool earlyCommitCallback(const CaptureBuffer& photodiodeData, uint16_t length);
+void windowCallback(const CaptureBuffer& photodiodeData);
+void reportPrediction(float* result);
 
 void setupPhotodiodes()
 {
@@ -32,50 +59,432 @@ void setupPhotodiodes()
 	}
 }
 
+void restoreThresholds()
+{
+	for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+	{
+		// A stored threshold that the current light is already below would trigger right away, use the reading instead
+		int reading = lightIntensityRegulator->getCalibrationReading(i);
+		int threshold = calibrationRecord.thresholds[i];
+		if (reading <= threshold)
+			threshold = reading * DETECTION_THRESHOLD_COEFF;
+
+		gestureDetector->setThreshold(i, threshold);
+	}
+}
+
 void setupGestureDetector()
 {
 	gestureDetector = new GestureDetector();
+
+	// Start with the thresholds of the last run instead of INITIAL_DETECTION_THRESHOLD
+	if (calibrationRestored)
+		restoreThresholds();
+
 	gestureDetector->setGestureDetectedCallback(gestureDetectedCallback);
+	gestureDetector->setEarlyCommitCallback(earlyCommitCallback);
+
+	#ifdef STREAMING_PREPROCESSING
+	gestureDetector->setCaptureSampleCallback([](const uint16_t sample[NUM_LIGHT_SENSORS], uint16_t index) {
+		modelWrapper->feedSample(sample, index);
+	});
+	#endif // STREAMING_PREPROCESSING
+
+	gestureDetector->setResetCallback([]() {
+		timer.restartTimer(sampleTimerID);
+		tickScheduler.resync();
+	});
+
+	// Feed the background calibration and switch gains between gestures
+	gestureDetector->setSampleCallback([](const uint16_t sample[NUM_LIGHT_SENSORS]) {
+		lightIntensityRegulator->feedSamples(sample);
+
+		if (lightIntensityRegulator->hasPendingGainChange())
+			gestureDetector->applyGainChange(lightIntensityRegulator->applyPendingGainChange());
+	});
+
+	// Keep the signal in the usable range when the ambient light changes between recalibrations
+	gestureDetector->setGainStepCallback([](int direction) {
+		bool switched = direction == GestureDetector::GAIN_STEP_UP ? lightIntensityRegulator->resistorUp() : lightIntensityRegulator->resistorDown();
+		return switched ? lightIntensityRegulator->getLastGainRatio() : 1.0f;
+	});
+
+	// Setup timer to call detect gesture every samplePeriod milliseconds
+	sampleTimerCallback = []() { gestureDetector->detectGesture(); };
+	sampleTimerID = timer.setInterval(samplePeriod, sampleTimerCallback);
+}
+
+// A hand passing over the light sensors one after the other: sample n of a capture of a light sensor
+uint16_t syntheticGestureSample(size_t sensor, size_t n)
+{
+	float shadow = exp(-pow((n - 30.0f - 15.0f * sensor) / 8.0f, 2));
+	return 700 - 500 * shadow + (n * 7 + sensor * 13) % 5;
+}
+
+void setupContinuousDetector()
+{
+	continuousDetector = new ContinuousDetector();
+	continuousDetector->setWindowCallback(windowCallback);
+
+	// Feed the background calibration, a gain change rescales the samples in the window
+	continuousDetector->setSampleCallback([](const uint16_t sample[NUM_LIGHT_SENSORS]) {
+		lightIntensityRegulator->feedSamples(sample);
+
+		if (lightIntensityRegulator->hasPendingGainChange())
+			continuousDetector->applyGainChange(lightIntensityRegulator->applyPendingGainChange());
+	});
+
+	if (calibrationRecordLoaded && calibrationRecord.modelVariant == MODEL_VARIANT && calibrationRecord.hopSize > 0)
+	{
+		// The hop size was already chosen for this model
+		continuousDetector->setHopSize(calibrationRecord.hopSize);
+	}
+	else
+	{
+		// Measure the cost of one inference to choose a hop size that fits within the duty cycle budget.
+		// No window has been sampled yet, and an empty one has no variance to standardise, so a synthetic gesture is used.
+		CaptureBuffer window;
+		for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+		{
+			for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+				CaptureLayout::At(window, i, j) = syntheticGestureSample(i, j);
+		}
+
+		modelWrapper->infer(window);
+		continuousDetector->selectHopSize(modelWrapper->getLastInferenceDuration());
+	}
+
+	// Setup timer to take a sample every samplePeriod milliseconds
+	sampleTimerCallback = []() { continuousDetector->sample(); };
+	sampleTimerID = timer.setInterval(samplePeriod, sampleTimerCallback);
+}
+
+bool configureSampling(unsigned long period, float cutoff)
+{
+	// The low pass filter is redesigned first, it rejects a cutoff above the Nyquist frequency of the new rate
+	if (period == 0 || !modelWrapper->setLowPassFilter(1000.0f / period, cutoff))
+		return false;
+
+	samplePeriod = period;
+	lowPassCutoff = cutoff;
+
+	if (gestureDetector != nullptr)
+		gestureDetector->setReadPeriod(period);
+	if (continuousDetector != nullptr)
+	{
+		continuousDetector->setReadPeriod(period);
+
+		// The hop is counted in samples, so the same inference cost needs another hop at another sampling period
+		if (modelWrapper->getLastInferenceDuration() > 0)
+			continuousDetector->selectHopSize(modelWrapper->getLastInferenceDuration());
+	}
+
+	// SimpleTimer cannot change the interval of a timer, so it is replaced by a new one
+	timer.deleteTimer(sampleTimerID);
+	sampleTimerID = timer.setInterval(period, sampleTimerCallback);
+
+	tickScheduler.setPeriod(period);
+	tickScheduler.resync();
+
+	return true;
+}
+
+// Handles the command in a received line, "r <period> <cutoff>" changes the sampling period in milliseconds and the
+// low pass cutoff in Hz
+void handleSerialCommand(const char* command)
+{
+	if (command[0] != 'r')
+		return;
+
+	char* end;
+	unsigned long period = strtoul(command + 1, &end, 10);
+	float cutoff = strtof(end, &end);
+
+	if (configureSampling(period, cutoff))
+	{
+		Serial.print("Sampling every ");
+		Serial.print(samplePeriod);
+		Serial.print(" ms, low pass cutoff at ");
+		Serial.print(lowPassCutoff);
+		Serial.println(" Hz.");
+	}
+	else
+	{
+		Serial.println("Invalid sampling configuration, the cutoff should be below half the sampling rate.");
+	}
+}
+
+// Collects the received characters into a line without waiting for the rest of it, so the sampling is never held up
+void handleSerialCommands()
+{
+	static char line[SERIAL_COMMAND_LENGTH];
+	static size_t length = 0;
+	static bool overflow = false;
+
+	while (Serial.available() > 0)
+	{
+		char c = Serial.read();
+
+		if (c != '\n' && c != '\r')
+		{
+			// A line that does not fit is dropped as a whole
+			if (length + 1 < SERIAL_COMMAND_LENGTH)
+				line[length++] = c;
+			else
+				overflow = true;
+			continue;
+		}
+
+		line[length] = '\0';
+		if (length > 0 && !overflow)
+			handleSerialCommand(line);
+
+		length = 0;
+		overflow = false;
+	}
+}
+
+#ifdef BENCHMARK_PREPROCESSING
+// Runs the fast pre-processing and writes the model input BENCHMARK_PREPROCESSING_RUNS times, returns the duration in microseconds
+template <typename P>
+unsigned long benchmarkLayout(P& preprocessor, const typename P::Capture& capture, float* modelInput)
+{
+	unsigned long start = micros();
+	for (int run = 0; run < BENCHMARK_PREPROCESSING_RUNS; run++)
+	{
+		preprocessor.runFastPipeline(capture);
+		ModelWrapper::reshapeInput(preprocessor.getPipelineOutput(), modelInput);
+	}
+	return micros() - start;
+}
+
+void benchmarkPreprocessing()
+{
+	static Preprocessor preprocessor;
+	static CaptureBuffer capture;
+	static Preprocessor::Output reference;
+
+	// The same capture in both layouts
+	static BasicPreprocessor<PlanarLayout>::Capture planarCapture;
+	static BasicPreprocessor<InterleavedLayout>::Capture interleavedCapture;
+
+	for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+	{
+		for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+		{
+			uint16_t sample = syntheticGestureSample(i, j);
+
+			CaptureLayout::At(capture, i, j) = sample;
+			planarCapture[i][j] = sample;
+			interleavedCapture[j][i] = sample;
+		}
+	}
+
+	unsigned long start = micros();
+	for (int run = 0; run < BENCHMARK_PREPROCESSING_RUNS; run++)
+		preprocessor.runReferencePipeline(capture);
+	unsigned long referenceUs = micros() - start;
+	memcpy(reference, preprocessor.getPipelineOutput(), sizeof(reference));
 
-	gestureDetector->setResetCallback([]() { timer.restartTimer(sampleTimerID); });
+	start = micros();
+	for (int run = 0; run < BENCHMARK_PREPROCESSING_RUNS; run++)
+		preprocessor.runFastPipeline(capture);
+	unsigned long fastUs = micros() - start;
 
-	// Setup timer to call detect gesture every READ_PERIOD milliseconds
-	sampleTimerID = timer.setInterval(READ_PERIOD, []() { gestureDetector->detectGesture(); });
+	Preprocessor::Output& fast = preprocessor.getPipelineOutput();
+	float maxError = 0;
+	for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+	{
+		for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+			maxError = fmaxf(maxError, fabsf(Preprocessor::OutputLayout::At(fast, i, j) - Preprocessor::OutputLayout::At(reference, i, j)));
+	}
+
+	Serial.print("Pre-processing: reference ");
+	Serial.print((float) referenceUs / BENCHMARK_PREPROCESSING_RUNS);
+	Serial.print(" us, fast ");
+	Serial.print((float) fastUs / BENCHMARK_PREPROCESSING_RUNS);
+	Serial.print(" us, largest difference ");
+	Serial.println(maxError, 7);
+
+	// The vectorised kernels against the plain loops, the statistics must be exact
+	bool statisticsMatch = true;
+	unsigned long scalarUs = 0;
+	unsigned long vectorUs = 0;
+	for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+	{
+		uint16_t scalarMax, vectorMax;
+		uint32_t scalarSum, vectorSum, scalarSquares, vectorSquares;
+
+		start = micros();
+		for (int run = 0; run < BENCHMARK_PREPROCESSING_RUNS; run++)
+			ScalarKernels::Statistics(planarCapture[i], GESTURE_BUFFER_LENGTH, scalarMax, scalarSum, scalarSquares);
+		scalarUs += micros() - start;
+
+		start = micros();
+		for (int run = 0; run < BENCHMARK_PREPROCESSING_RUNS; run++)
+			Kernels::Statistics(planarCapture[i], GESTURE_BUFFER_LENGTH, vectorMax, vectorSum, vectorSquares);
+		vectorUs += micros() - start;
+
+		statisticsMatch &= scalarMax == vectorMax && scalarSum == vectorSum && scalarSquares == vectorSquares;
+	}
+
+	Serial.print("Statistics kernel: scalar ");
+	Serial.print((float) scalarUs / BENCHMARK_PREPROCESSING_RUNS);
+	Serial.print(" us, ");
+	Serial.print(Kernels::Name());
+	Serial.print(" ");
+	Serial.print((float) vectorUs / BENCHMARK_PREPROCESSING_RUNS);
+	Serial.print(" us, ");
+	Serial.println(statisticsMatch ? "results match." : "RESULTS DIFFER!");
+
+	// From the capture up to the model input in both layouts, the model input must be the same
+	static BasicPreprocessor<PlanarLayout> planar;
+	static BasicPreprocessor<InterleavedLayout> interleaved;
+	static float planarInput[NUM_DATAPOINTS * NUM_LIGHT_SENSORS];
+	static float interleavedInput[NUM_DATAPOINTS * NUM_LIGHT_SENSORS];
+
+	unsigned long planarUs = benchmarkLayout(planar, planarCapture, planarInput);
+	unsigned long interleavedUs = benchmarkLayout(interleaved, interleavedCapture, interleavedInput);
+	bool inputsMatch = memcmp(planarInput, interleavedInput, sizeof(planarInput)) == 0;
+
+	Serial.print("Fast pre-processing and model input: planar ");
+	Serial.print((float) planarUs / BENCHMARK_PREPROCESSING_RUNS);
+	Serial.print(" us, interleaved ");
+	Serial.print((float) interleavedUs / BENCHMARK_PREPROCESSING_RUNS);
+	Serial.print(" us, ");
+	Serial.println(inputsMatch ? "model inputs match." : "MODEL INPUTS DIFFER!");
+
+	// Stretching an adaptive length capture of every light sensor onto GESTURE_BUFFER_LENGTH samples
+	const Resampler::Mode resampleModes[] = {Resampler::LINEAR, Resampler::POLYPHASE};
+	const char* resampleModeNames[] = {"linear", "polyphase"};
+	const int resampleLengths[] = {MIN_CAPTURE_LENGTH, GESTURE_BUFFER_LENGTH * 2 / 3};
+	static uint16_t stretched[GESTURE_BUFFER_LENGTH];
+	for (size_t m = 0; m < 2; m++)
+	{
+		Serial.print("Resampler, ");
+		Serial.print(resampleModeNames[m]);
+		for (size_t l = 0; l < 2; l++)
+		{
+			Resampler resampler(resampleModes[m]);
+
+			start = micros();
+			for (int run = 0; run < BENCHMARK_PREPROCESSING_RUNS; run++)
+			{
+				for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+					resampler.Resample(planarCapture[i], resampleLengths[l], stretched, GESTURE_BUFFER_LENGTH);
+			}
+			unsigned long resampleUs = micros() - start;
+
+			Serial.print(l == 0 ? ": from " : ", from ");
+			Serial.print(resampleLengths[l]);
+			Serial.print(" samples ");
+			Serial.print((float) resampleUs / BENCHMARK_PREPROCESSING_RUNS);
+			Serial.print(" us");
+		}
+		Serial.println(" per capture.");
+	}
 }
+#endif // BENCHMARK_PREPROCESSING
 
 void recalibrate()
 {
-	// Disable timer to prevent the gesture detector from running while the sensors are being recalibrated
-	timer.disable(sampleTimerID);
+	// The light sensors are recalibrated in the background on the samples of the gesture detector,
+	// so the sampling timer keeps running and gestures can still be detected.
+	lightIntensityRegulator->startBackgroundCalibration();
+}
 
-	// Turn on the red LED to indicate that the recalibration has started
-	setLedColour(RED);
+void storeCalibration()
+{
+	CalibrationRecord record = calibrationRecord;
+
+	record.resistorIndex = lightIntensityRegulator->getResistorIndex();
+	for (size_t i = 0; i < POWER_SET_SIZE; i++)
+		record.gains[i] = lightIntensityRegulator->getGain(i);
+
+	// The hop size depends on the sampling period, and the next boot samples at READ_PERIOD
+	if (continuousDetector != nullptr && samplePeriod == READ_PERIOD)
+		record.hopSize = continuousDetector->getHopSize();
+	else if (record.modelVariant != MODEL_VARIANT)
+		record.hopSize = 0;
+	record.modelVariant = MODEL_VARIANT;
+
+	// Only rewrite the flash when something changed enough to matter at the next boot
+	bool changed = !calibrationRecordLoaded ||
+		record.resistorIndex != calibrationRecord.resistorIndex ||
+		record.modelVariant != calibrationRecord.modelVariant ||
+		record.hopSize != calibrationRecord.hopSize;
+
+	if (gestureDetector != nullptr)
+	{
+		for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+		{
+			record.thresholds[i] = gestureDetector->getThreshold(i);
+			if (abs(record.thresholds[i] - calibrationRecord.thresholds[i]) > calibrationRecord.thresholds[i] * CALIBRATION_STORE_TOLERANCE)
+				changed = true;
+		}
+	}
+
+	if (!changed)
+		return;
+
+	if (storeCalibrationRecord(&record))
+	{
+		calibrationRecord = record;
+		calibrationRecordLoaded = true;
+	}
+	else
+	{
+		Serial.println("Storing the calibration failed.");
+	}
+}
 
-	// Recalibrate the light sensors. This will change the LED to indicate the result of the recalibration.
-	lightIntensityRegulator->calibrateSensors();
+// Erasing the flash stalls the program for tens of milliseconds. A capture runs within a single call of the sample timer,
+// so loop() is always between gestures, but with idle sensing the store also waits until the light sensors are quiet.
+void storePendingCalibration()
+{
+	if (!calibrationStorePending)
+		return;
 
-	// Recalibrate the gesture detector
-	gestureDetector->recalibrateThresholds();
+	#ifdef IDLE_SENSING
+	if (gestureDetector != nullptr && !gestureDetector->isIdle())
+		return;
+	#endif // IDLE_SENSING
 
-	// Re-enable the timer
-	timer.enable(sampleTimerID);
+	calibrationStorePending = false;
+	storeCalibration();
 }
 
 void setupLightIntensityRegulator()
 {
 	lightIntensityRegulator = new LightIntensityRegulator();
-	// recalibrateTimerID = timer.setInterval(RECALIBRATE_PERIOD, []() { 
-	// 	timer.disable(sampleTimerID);
-	// 	lightIntensityRegulator->calibrateSensors();
-	// 	gestureDetector->recalibrateThresholds();
-	// 	timer.enable(sampleTimerID);
-	// });
+
+	if (calibrationRecordLoaded)
+	{
+		lightIntensityRegulator->restoreCalibration(calibrationRecord.resistorIndex, calibrationRecord.gains);
+		calibrationRestored = lightIntensityRegulator->verifyCalibration();
+	}
+
+	if (!calibrationRestored)
+		lightIntensityRegulator->calibrateSensors();
+
+	recalibrateTimerID = timer.setInterval(RECALIBRATE_PERIOD, recalibrate);
 }
 
 void setup()
 {
 	Serial.begin(115200);
-	delay(3000);
+
+	#ifdef PERSIST_CALIBRATION
+	calibrationRecordLoaded = loadCalibrationRecord(&calibrationRecord);
+	#endif // PERSIST_CALIBRATION
+
+	// Give some time to open the serial monitor, but don't slow down a warm boot
+	if (!calibrationRecordLoaded)
+		delay(3000);
+
+	#ifdef BENCHMARK_PREPROCESSING
+	benchmarkPreprocessing();
+	#endif // BENCHMARK_PREPROCESSING
 
 	Serial.print("Setup started...");
 
@@ -90,13 +499,33 @@ void setup()
 	setupLightIntensityRegulator();
 
 	// Add delay so result (LED colour) of recalibration is visible
-	delay(1000);
-
-	setupGestureDetector();
+	if (!calibrationRestored)
+		delay(1000);
 
 	// Setup model wrapper which will load the model and handle all machine learning related stuff
 	modelWrapper = new ModelWrapper();
 
+	#ifdef CONTINUOUS_INFERENCE
+	setupContinuousDetector();
+	#else
+	setupGestureDetector();
+	#endif // CONTINUOUS_INFERENCE
+
+	#ifdef PERSIST_CALIBRATION
+	// Store the first calibration once the thresholds have been learned, after that only when it changed
+	if (!calibrationRecordLoaded)
+		timer.setTimeout(CALIBRATION_FIRST_STORE_DELAY, []() { calibrationStorePending = true; });
+	timer.setInterval(CALIBRATION_STORE_PERIOD, []() { calibrationStorePending = true; });
+	#endif // PERSIST_CALIBRATION
+
+	#ifdef REPORT_DUTY_CYCLE
+	timer.setInterval(DUTY_CYCLE_REPORT_PERIOD, []() { tickScheduler.report(); });
+	#endif // REPORT_DUTY_CYCLE
+
+	// Align the sleep of the tick scheduler to the sampling timer
+	timer.restartTimer(sampleTimerID);
+	tickScheduler.resync();
+
 	// Turn on the blue LED to indicate that the setup has finished 
 	// and the device is ready to start collecting data
 	setLedColour(BLUE);
@@ -106,11 +535,34 @@ void setup()
 
 void loop()
 {
+	handleSerialCommands();
+
 	timer.run();
+
+	#ifdef PERSIST_CALIBRATION
+	storePendingCalibration();
+	#endif // PERSIST_CALIBRATION
+
+	#ifdef LOW_POWER_IDLE
+	tickScheduler.sleepUntilNextTick();
+	#endif // LOW_POWER_IDLE
 }
 
-void gestureDetectedCallback(uint16_t photodiodeData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH])
+void gestureDetectedCallback(const CaptureBuffer& photodiodeData)
 {
+	#ifdef GESTURE_GATE
+	// Don't waste an inference on captures that cannot contain a gesture
+	GateResult gateResult = gestureGate.check(photodiodeData);
+	if (gateResult != GATE_ACCEPTED)
+	{
+		Serial.print("Capture rejected by gate: ");
+		Serial.println(gateResultName(gateResult));
+
+		setLedColour(BLUE);
+		return;
+	}
+	#endif // GESTURE_GATE
+
 	// When data collection is done set it to white to indicate that inference is running.
 	setLedColour(WHITE);
 
@@ -120,6 +572,52 @@ void gestureDetectedCallback(uint16_t photodiodeData[NUM_LIGHT_SENSORS][GESTURE_
 
 	float* result = modelWrapper->infer(photodiodeData);
 
+	reportPrediction(result);
+}
+
+bool earlyCommitCallback(const CaptureBuffer& photodiodeData, uint16_t length)
+{
+	#ifdef GESTURE_GATE
+	// A partial capture the gate rejects is not committed, the full capture is gated again at the end
+	if (gestureGate.check(photodiodeData, length) != GATE_ACCEPTED)
+		return false;
+	#endif // GESTURE_GATE
+
+	float* result = modelWrapper->infer(photodiodeData, length);
+
+	// Keep capturing when the model is not yet sure enough about the gesture
+	if (modelWrapper->getConfidenceMargin() < EARLY_COMMIT_MARGIN)
+		return false;
+
+	setLedColour(WHITE);
+
+	Serial.print("Committed early after ");
+	Serial.print(length);
+	Serial.print(" samples. ");
+
+	reportPrediction(result);
+
+	return true;
+}
+
+void windowCallback(const CaptureBuffer& photodiodeData)
+{
+	float* result = modelWrapper->infer(photodiodeData);
+
+	// Windows without a clear winner are treated as "no gesture"
+	if (result[modelWrapper->getPredictedIndex()] < CONTINUOUS_SCORE_GATE)
+		return;
+
+	setLedColour(WHITE);
+
+	reportPrediction(result);
+
+	// The same gesture is still (partially) in the next windows, don't report it again
+	continuousDetector->suppress(GESTURE_BUFFER_LENGTH);
+}
+
+void reportPrediction(float* result)
+{
 	// Print the result array.
 	Serial.print("Result array: ");
 	for (size_t i = 0; i < NUM_FEATURES; i++)
@@ -131,14 +629,7 @@ void gestureDetectedCallback(uint16_t photodiodeData[NUM_LIGHT_SENSORS][GESTURE_
 	Serial.println();
 
 	// Get the index of the highest value in the result array.
-	int maxIndex = 0;
-	for (size_t i = 0; i < NUM_FEATURES; i++)
-	{
-		if (result[i] > result[maxIndex])
-		{
-			maxIndex = i;
-		}
-	}
+	int maxIndex = modelWrapper->getPredictedIndex();
 
 	// Print the gesture name and confidence
 	Serial.print("Predicted gesture: ");
@@ -150,8 +641,10 @@ void gestureDetectedCallback(uint16_t photodiodeData[NUM_LIGHT_SENSORS][GESTURE_
 	setLedColour(RED);
 
 	// Add a delay to slow down the serial prints and avoid detecting the same gesture multiple times.
-	// Can be removed if desired.
-	delay(500);
+	// Can be removed if desired. Continuous detection keeps sampling at its rate instead, a stall would make the
+	// sampling timer catch up in a burst and compress the next windows, suppress() already prevents a double report.
+	if (continuousDetector == nullptr)
+		delay(500);
 
 	// Turn on the blue LED to indicate that it is ready to start collecting data again.
 	setLedColour(BLUE);
@@ -1,37 +1,23 @@
 #include "ModelWrapper.hpp"
 
+#include <new>
+
 #include "model_data.hpp" // The model converted by xxd -i
+#include "gestures.hpp"
 
 // Uncomment this to _remove_ error reporting and lower memory space usage
 // #define TF_LITE_STRIP_ERROR_STRINGS
 
 // The tensor arena size needs to be determined by experimentation.
 // We need to preallocate memory for the model's tensors.
+// With HIERARCHICAL_MODEL it holds the family model and the largest specialist model together.
+// With EARLY_EXIT_MODEL it holds both stages together.
 const int tensor_arena_size = 8192;
 
 ModelWrapper::ModelWrapper()
 {
 	// Make use of the micro error reporter because it consumes less space
 	error_reporter = tflite::GetMicroErrorReporter();
-	
-	model = tflite::GetModel(converted_model_tflite);
-
-	// Make sure our model is running the same version of TensorFlow as we are
-	if (model->version() != TFLITE_SCHEMA_VERSION)
-	{
-		// From (tensorflow/lite/core/api/error_reporter.h):
-		// You should not make bare calls to the error reporter, instead use the
-		// TF_LITE_REPORT_ERROR macro, since this allows message strings to be
-		// stripped when the binary size has to be optimized. If you are looking to
-		// reduce binary size, define TF_LITE_STRIP_ERROR_STRINGS when compiling and
-		// every call will be stubbed out, taking no memory.
-
-		TF_LITE_REPORT_ERROR(error_reporter,
-							 "Model provided is schema version %d not equal "
-							 "to supported version %d.",
-							 model->version(), TFLITE_SCHEMA_VERSION);
-		return;
-	}
 
 	resolver = new tflite::MicroMutableOpResolver<12>();
 
@@ -58,33 +44,112 @@ ModelWrapper::ModelWrapper()
 		return;
 	}
 
-	// Build an interpreter to run the model with
-	static tflite::MicroInterpreter static_interpreter(model, *resolver, tensor_arena, tensor_arena_size);
-	interpreter = &static_interpreter;
+	// Create preprocessor
+	preprocessor = new Preprocessor();
 
-	// Allocate memory from the tensor_arena for the model's tensors
-	TfLiteStatus allocate_status = interpreter->AllocateTensors();
-	if (allocate_status != kTfLiteOk)
+	#ifdef HIERARCHICAL_MODEL
+	// The family model stays loaded and the specialists share the rest of the tensor arena.
+	// Load each specialist once to check that it fits and to report the arena usage, they are loaded on demand afterwards.
+	if (!loadFamilyModel())
+		return;
+
+	size_t peak_bytes = 0;
+	for (size_t i = 0; i < NUM_GESTURE_FAMILIES; i++)
 	{
-		TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+		if (!loadModel(SPECIALIST_MODELS[i], family_arena_size))
+			return;
 
-		return;
+		if (interpreter->arena_used_bytes() > peak_bytes)
+			peak_bytes = interpreter->arena_used_bytes();
 	}
+	loaded_specialist = NUM_GESTURE_FAMILIES - 1;
 
-	// Create preprocessor
-	preprocessor = new Preprocessor();
+	TF_LITE_REPORT_ERROR(error_reporter, "Used bytes family model %d, largest specialist %d\n", family_arena_size, peak_bytes);
+	#elif defined(EARLY_EXIT_MODEL)
+	if (!loadEarlyExitStages())
+		return;
+
+	TF_LITE_REPORT_ERROR(error_reporter, "Used bytes stage 1 %d, stage 2 %d\n",
+						 stage_1_arena_size, stage_2_interpreter->arena_used_bytes());
+	#else
+	if (!loadModel(converted_model_tflite))
+		return;
 
 	// Use this to specify the tensor_arena_size
 	size_t used_bytes = interpreter->arena_used_bytes();
     TF_LITE_REPORT_ERROR(error_reporter, "Used bytes %d\n", used_bytes);
+	#endif // HIERARCHICAL_MODEL
+}
+
+// The part of the tensor arena a model needs that stays loaded below another one: its used bytes, with room for
+// the alignment of the start of its arena and so that the next arena starts aligned as well
+static size_t residentArenaSize(size_t usedBytes)
+{
+	const size_t alignment = 16;
+	return (usedBytes + 2 * alignment - 1) & ~(alignment - 1);
+}
+
+bool ModelWrapper::loadModel(const unsigned char* modelData, size_t arenaOffset, size_t arenaSize)
+{
+	model = tflite::GetModel(modelData);
+
+	// Make sure our model is running the same version of TensorFlow as we are
+	if (model->version() != TFLITE_SCHEMA_VERSION)
+	{
+		// From (tensorflow/lite/core/api/error_reporter.h):
+		// You should not make bare calls to the error reporter, instead use the
+		// TF_LITE_REPORT_ERROR macro, since this allows message strings to be
+		// stripped when the binary size has to be optimized. If you are looking to
+		// reduce binary size, define TF_LITE_STRIP_ERROR_STRINGS when compiling and
+		// every call will be stubbed out, taking no memory.
+
+		TF_LITE_REPORT_ERROR(error_reporter,
+							 "Model provided is schema version %d not equal "
+							 "to supported version %d.",
+							 model->version(), TFLITE_SCHEMA_VERSION);
+		return false;
+	}
+
+	// Build an interpreter to run the model with. It is constructed in place so that
+	// loading another model into the same tensor arena does not need any heap memory.
+	if (interpreter != nullptr)
+		interpreter->~MicroInterpreter();
+	if (arenaSize == 0)
+		arenaSize = tensor_arena_size - arenaOffset;
+	interpreter = new (interpreter_buffer) tflite::MicroInterpreter(model, *resolver, tensor_arena + arenaOffset, arenaSize);
+
+	// Allocate memory from the tensor_arena for the model's tensors
+	TfLiteStatus allocate_status = interpreter->AllocateTensors();
+	if (allocate_status != kTfLiteOk)
+	{
+		TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+
+		return false;
+	}
 
 	// Get pointers to the model's input and output tensors
 	input = interpreter->typed_input_tensor<float>(0);
 	output = interpreter->typed_output_tensor<float>(0);
+
+	return true;
 }
 
-float* ModelWrapper::infer(uint16_t inputData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH]) 
+float* ModelWrapper::infer(const CaptureBuffer& capture, uint16_t length) 
 {
+	const CaptureBuffer* inputData = &capture;
+	if (length > 0 && length < GESTURE_BUFFER_LENGTH)
+	{
+		// Provisional inference on a partial window: pad the missing samples with the last captured sample
+		// so the model sees a signal that has settled instead of a sudden drop to zero.
+		for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+		{
+			for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+				CaptureLayout::At(paddedData, i, j) = CaptureLayout::At(capture, i, j < length ? j : length - 1);
+		}
+
+		inputData = &paddedData;
+	}
+
 	#ifdef DEBUG_PRINTS
 	Serial.println("Input data before processing:");
 	Serial.print("[");
@@ -93,7 +158,7 @@ float* ModelWrapper::infer(uint16_t inputData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_
 		Serial.print("[");
 		for (int j = 0; j < NUM_LIGHT_SENSORS; j++)
 		{
-			Serial.print(inputData[j][i]);
+			Serial.print(CaptureLayout::At(*inputData, j, i));
 			if (j < NUM_LIGHT_SENSORS - 1) {
 				Serial.print(", ");
 			}
@@ -109,17 +174,28 @@ float* ModelWrapper::infer(uint16_t inputData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_
 
 	// Serial.print("Running pre-processing pipeline...");
 	auto start = micros();
-	preprocessor->runPipeline(inputData);
+	#ifdef STREAMING_PREPROCESSING
+	// The capture was pre-processed while it was acquired, unless it is a partial window or a sample was missed
+	if (length == GESTURE_BUFFER_LENGTH && preprocessor->isStreamComplete())
+		preprocessor->finalizeStream();
+	else
+		preprocessor->runPipeline(*inputData);
+	#else
+	preprocessor->runPipeline(*inputData);
+	#endif // STREAMING_PREPROCESSING
 	auto stop = micros();
 
 	// Calculate the time it took to run the inference
 	auto duration = stop - start;
+	lastInferenceDuration = duration;
 
+	#ifdef DEBUG_PRINTS
 	Serial.print("Pre-processing done in: ");
 	Serial.print(duration);
 	Serial.print(" microseconds. ");
+	#endif // DEBUG_PRINTS
 
-	float (* processedData)[100] = preprocessor->getPipelineOutput();
+	Preprocessor::Output& processedData = preprocessor->getPipelineOutput();
 	
 	#ifdef DEBUG_PRINTS
 	Serial.println("Input data after processing:");
@@ -129,7 +205,7 @@ float* ModelWrapper::infer(uint16_t inputData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_
 		Serial.print("[");
 		for (int j = 0; j < NUM_LIGHT_SENSORS; j++)
 		{
-			float value = processedData[j][i];
+			float value = Preprocessor::OutputLayout::At(processedData, j, i);
 			Serial.print(value);
 			if (j < NUM_LIGHT_SENSORS - 1) {
 				Serial.print(", ");
@@ -144,24 +220,43 @@ float* ModelWrapper::infer(uint16_t inputData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_
 	Serial.println("]");
 	#endif // DEBUG_PRINTS
 
-	// Before passing the data to the model we need to reshape the data to the expected shape (20, 5, 3)
-	// We can do this by reinterpreting the array with different indices.
-	// Because the model is trained on a transposed version of the data, we need to transpose the data before passing it to the model.
-	// float (* reshapedData)[DIM1][DIM2][DIM3] = (float (*)[DIM1][DIM2][DIM3]) processedData;
-	float (* reshapedData)[DIM3][DIM2][DIM1] = (float (*)[DIM3][DIM2][DIM1]) processedData;
+	#ifdef HIERARCHICAL_MODEL
+	// The input is needed for two models that share the arena, so keep it outside of the arena
+	reshapeInput(processedData, model_input);
 
-	size_t current_index = 0;
-	for (int dim2 = 0; dim2 < DIM2; dim2++)
-	{
-		for (int dim1 = 0; dim1 < DIM1; dim1++)
-		{
-			for (int dim3 = 0; dim3 < DIM3; dim3++)
-			{
-				input[current_index] = (*reshapedData)[dim3][dim2][dim1];
-				current_index++;
-			}
-		}
-	}
+	start = micros();
+	float* result = inferHierarchical();
+	stop = micros();
+
+	duration = stop - start;
+	lastInferenceDuration += duration;
+
+	// The time includes loading the specialist model, when the family changed since the last inference
+	Serial.print("Hierarchical inference finished in: ");
+	Serial.print(duration);
+	Serial.println(specialist_reloaded ? " microseconds, specialist model loaded." : " microseconds.");
+
+	return result;
+	#elif defined(EARLY_EXIT_MODEL)
+	reshapeInput(processedData, input);
+
+	start = micros();
+	float* result = inferEarlyExit();
+	stop = micros();
+
+	duration = stop - start;
+	lastInferenceDuration += duration;
+
+	Serial.print("Inference finished at exit ");
+	Serial.print(lastExit);
+	Serial.print(" in: ");
+	Serial.print(duration);
+	Serial.println(" microseconds.");
+
+	return result;
+	#else
+	reshapeInput(processedData, input);
+	#endif // HIERARCHICAL_MODEL
 
 	// Run the model on this input and make sure it succeeds
 	start = micros();
@@ -170,6 +265,7 @@ float* ModelWrapper::infer(uint16_t inputData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_
 
 	// Calculate the time it took to run the inference
 	duration = stop - start;
+	lastInferenceDuration += duration;
 
 	Serial.print("Inference finished in: ");
 	Serial.print(duration);
@@ -182,4 +278,207 @@ float* ModelWrapper::infer(uint16_t inputData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_
 
 	// Return the prediction array from the model's output tensor
 	return output;
+}
+
+// Before passing the data to the model we need to reshape the data to the expected shape (20, 5, 3)
+// We can do this by reinterpreting the array with different indices.
+// Because the model is trained on a transposed version of the data, we need to transpose the data before passing it to the model.
+void ModelWrapper::reshapeInput(const PlanarLayout<NUM_LIGHT_SENSORS, NUM_DATAPOINTS>::Signal& processedData, float* destination)
+{
+	// float (* reshapedData)[DIM1][DIM2][DIM3] = (float (*)[DIM1][DIM2][DIM3]) processedData;
+	const float (* reshapedData)[DIM3][DIM2][DIM1] = (const float (*)[DIM3][DIM2][DIM1]) processedData;
+
+	size_t current_index = 0;
+	for (int dim2 = 0; dim2 < DIM2; dim2++)
+	{
+		for (int dim1 = 0; dim1 < DIM1; dim1++)
+		{
+			for (int dim3 = 0; dim3 < DIM3; dim3++)
+			{
+				destination[current_index] = (*reshapedData)[dim3][dim2][dim1];
+				current_index++;
+			}
+		}
+	}
+}
+
+// An interleaved capture already is in the order of the model input, (20, 5, 3) is [NUM_DATAPOINTS][NUM_LIGHT_SENSORS]
+// reinterpreted. It is only copied because the input tensor lives in the tensor arena.
+void ModelWrapper::reshapeInput(const InterleavedLayout<NUM_LIGHT_SENSORS, NUM_DATAPOINTS>::Signal& processedData, float* destination)
+{
+	static_assert(DIM1 * DIM2 == NUM_DATAPOINTS && DIM3 == NUM_LIGHT_SENSORS, "The model input is time major");
+
+	memcpy(destination, processedData, sizeof(processedData));
+}
+
+#ifdef HIERARCHICAL_MODEL
+// An interpreter keeps its persistent buffers at the end of the arena it is given, so the family model is first loaded
+// into the whole arena to measure how much it needs, and then into only that part of it.
+bool ModelWrapper::loadFamilyModel()
+{
+	if (!loadModel(family_model_tflite))
+		return false;
+
+	family_arena_size = residentArenaSize(interpreter->arena_used_bytes());
+
+	interpreter->~MicroInterpreter();
+	interpreter = nullptr;
+
+	family_interpreter = new (family_interpreter_buffer) tflite::MicroInterpreter(model, *resolver, tensor_arena, family_arena_size);
+	if (family_interpreter->AllocateTensors() != kTfLiteOk)
+	{
+		TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() of family model failed");
+		return false;
+	}
+
+	return true;
+}
+
+// First classifies the gesture family with a tiny model, then runs the specialist model of that family to classify
+// the gesture within the family. The specialist is only loaded when the family differs from the last inference.
+// The scores are combined into one NUM_FEATURES result array.
+float* ModelWrapper::inferHierarchical()
+{
+	memcpy(family_interpreter->typed_input_tensor<float>(0), model_input, sizeof(model_input));
+	if (family_interpreter->Invoke() != kTfLiteOk)
+	{
+		TF_LITE_REPORT_ERROR(error_reporter, "Invoke of family model failed");
+		return hierarchical_output;
+	}
+
+	const float* familyScores = family_interpreter->typed_output_tensor<float>(0);
+	int family = 0;
+	for (size_t i = 0; i < NUM_GESTURE_FAMILIES; i++)
+	{
+		if (familyScores[i] > familyScores[family])
+			family = i;
+	}
+	float familyScore = familyScores[family];
+
+	specialist_reloaded = family != loaded_specialist;
+	if (specialist_reloaded)
+	{
+		loaded_specialist = -1;
+		if (!loadModel(SPECIALIST_MODELS[family], family_arena_size))
+			return hierarchical_output;
+		loaded_specialist = family;
+	}
+
+	memcpy(interpreter->typed_input_tensor<float>(0), model_input, sizeof(model_input));
+	if (interpreter->Invoke() != kTfLiteOk)
+	{
+		TF_LITE_REPORT_ERROR(error_reporter, "Invoke of specialist model failed");
+		return hierarchical_output;
+	}
+
+	// Gestures outside of the chosen family get a score of zero
+	const float* specialistScores = interpreter->typed_output_tensor<float>(0);
+	for (size_t i = 0; i < NUM_FEATURES; i++)
+		hierarchical_output[i] = 0;
+	for (size_t i = 0; i < GESTURE_FAMILY_SIZES[family]; i++)
+		hierarchical_output[GESTURE_FAMILY_OFFSETS[family] + i] = familyScore * specialistScores[i];
+
+	// The margin and predicted index are computed over the combined scores
+	output = hierarchical_output;
+
+	return hierarchical_output;
+}
+#endif // HIERARCHICAL_MODEL
+
+#ifdef EARLY_EXIT_MODEL
+// Both stages share the tensor arena and stay allocated between inferences, so the features of the first stage can
+// be copied straight into the input of the second stage. Like the family model of the hierarchical model, the first
+// stage is loaded into the whole arena to measure how much it needs, and then into only that part of it.
+bool ModelWrapper::loadEarlyExitStages()
+{
+	if (!loadModel(early_exit_stage_1_tflite))
+		return false;
+
+	stage_1_arena_size = residentArenaSize(interpreter->arena_used_bytes());
+	if (!loadModel(early_exit_stage_1_tflite, 0, stage_1_arena_size))
+		return false;
+
+	const tflite::Model* stage_2_model = tflite::GetModel(early_exit_stage_2_tflite);
+	stage_2_interpreter = new (stage_2_interpreter_buffer) tflite::MicroInterpreter(stage_2_model, *resolver, tensor_arena + stage_1_arena_size,
+																					  tensor_arena_size - stage_1_arena_size);
+
+	if (stage_2_interpreter->AllocateTensors() != kTfLiteOk)
+	{
+		// Without the second stage every inference exits after the first one
+		TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() of second stage failed, it does not fit above the first stage");
+		stage_2_interpreter->~MicroInterpreter();
+		stage_2_interpreter = nullptr;
+		return false;
+	}
+
+	// The first stage has two outputs, the block 1 features and the scores of the exit head
+	exit_output_index = interpreter->output(0)->bytes == NUM_FEATURES * sizeof(float) ? 0 : 1;
+
+	return true;
+}
+
+// Runs the first conv block and the auxiliary head. Only when the head is not confident enough,
+// the features of the first block are passed through the rest of the network.
+float* ModelWrapper::inferEarlyExit()
+{
+	if (interpreter->Invoke() != kTfLiteOk)
+	{
+		TF_LITE_REPORT_ERROR(error_reporter, "Invoke of first stage failed");
+		return output;
+	}
+
+	output = interpreter->typed_output_tensor<float>(exit_output_index);
+	lastExit = 1;
+
+	if (output[getPredictedIndex()] >= EARLY_EXIT_THRESHOLD || stage_2_interpreter == nullptr)
+		return output;
+
+	const TfLiteTensor* features = interpreter->output(1 - exit_output_index);
+	memcpy(stage_2_interpreter->typed_input_tensor<float>(0), interpreter->typed_output_tensor<float>(1 - exit_output_index), features->bytes);
+
+	if (stage_2_interpreter->Invoke() != kTfLiteOk)
+	{
+		TF_LITE_REPORT_ERROR(error_reporter, "Invoke of second stage failed");
+		return output;
+	}
+
+	output = stage_2_interpreter->typed_output_tensor<float>(0);
+	lastExit = 2;
+
+	return output;
+}
+#endif // EARLY_EXIT_MODEL
+
+float ModelWrapper::getConfidenceMargin()
+{
+	float highest = 0;
+	float secondHighest = 0;
+	for (size_t i = 0; i < NUM_FEATURES; i++)
+	{
+		if (output[i] > highest)
+		{
+			secondHighest = highest;
+			highest = output[i];
+		}
+		else if (output[i] > secondHighest)
+		{
+			secondHighest = output[i];
+		}
+	}
+
+	return highest - secondHighest;
+}
+
+int ModelWrapper::getPredictedIndex()
+{
+	int maxIndex = 0;
+	for (size_t i = 0; i < NUM_FEATURES; i++)
+	{
+		if (output[i] > output[maxIndex])
+		{
+			maxIndex = i;
+		}
+	}
+
+	return maxIndex;
 }
\ No newline at end of file
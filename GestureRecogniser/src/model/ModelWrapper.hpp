@@ -13,6 +13,23 @@
 
 #include "../pre-processing/preprocessor.hpp"
 
+#ifdef HIERARCHICAL_MODEL
+#include "hierarchical_model_data.hpp"
+#endif // HIERARCHICAL_MODEL
+
+#ifdef EARLY_EXIT_MODEL
+#include "early_exit_model_data.hpp"
+#endif // EARLY_EXIT_MODEL
+
+// Identifies the compiled model, so stored settings that were measured for another model are not reused.
+#if defined(HIERARCHICAL_MODEL)
+#define MODEL_VARIANT 1
+#elif defined(EARLY_EXIT_MODEL)
+#define MODEL_VARIANT 2
+#else
+#define MODEL_VARIANT 0
+#endif
+
 class ModelWrapper
 {
 public:
@@ -21,21 +38,100 @@ public:
         delete preprocessor;
     }
 
-    // This methods preprocesses the input data, reshapes it and then runs the model on it
-    float* infer(uint16_t input[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH]);
+    // This methods preprocesses the input data, reshapes it and then runs the model on it.
+    // When all samples of the input were fed with feedSample, only the end of the pre-processing is run.
+    // When length is smaller than GESTURE_BUFFER_LENGTH only the first length samples are used,
+    // the rest of the window is padded with the last captured sample (provisional inference).
+    float* infer(const CaptureBuffer& input, uint16_t length = GESTURE_BUFFER_LENGTH);
+
+    // Difference between the highest and the second highest score of the last inference.
+    // Used to decide whether a provisional prediction is confident enough to commit to.
+    float getConfidenceMargin();
+
+    // Index of the class with the highest score of the last inference
+    int getPredictedIndex();
+
+    // Pre-processing plus inference time of the last call to infer in microseconds
+    unsigned long getLastInferenceDuration() { return lastInferenceDuration; }
+
+    // Feeds one sample of a capture to the streaming pre-processing, see Preprocessor::feedSample
+    void feedSample(const uint16_t sample[NUM_LIGHT_SENSORS], uint16_t index) { preprocessor->feedSample(sample, index); }
+
+    // Redesigns the low pass filter of the pre-processing, see Preprocessor::setLowPassFilter
+    bool setLowPassFilter(float sampleRate, float cutoff) { return preprocessor->setLowPassFilter(sampleRate, cutoff); }
+
+    // Exit of the early exit model that produced the last result, 1 for the auxiliary head and 2 for the full network
+    int getLastExit() { return lastExit; }
+
+    // Writes the pre-processed data in the shape (20, 5, 3) the model expects to destination.
+    // The model input is time major, so a capture per light sensor is transposed and an interleaved capture is copied.
+    static void reshapeInput(const PlanarLayout<NUM_LIGHT_SENSORS, NUM_DATAPOINTS>::Signal& processedData, float* destination);
+    static void reshapeInput(const InterleavedLayout<NUM_LIGHT_SENSORS, NUM_DATAPOINTS>::Signal& processedData, float* destination);
 
 private:
     tflite::MicroMutableOpResolver<12>* resolver;
     tflite::ErrorReporter* error_reporter;
     const tflite::Model* model;
-    tflite::MicroInterpreter* interpreter;
+    tflite::MicroInterpreter* interpreter = nullptr;
+
+    // Storage for the interpreter, it is rebuilt in place whenever another model is loaded into the tensor arena
+    alignas(tflite::MicroInterpreter) uint8_t interpreter_buffer[sizeof(tflite::MicroInterpreter)];
 
     Preprocessor* preprocessor;
     
     float* input;
     float* output;
 
+    unsigned long lastInferenceDuration = 0;
+    int lastExit = 2;
+
     uint8_t* tensor_arena;
+
+    // Holds a partial capture padded to the full window length
+    CaptureBuffer paddedData;
+
+    // Loads a model into arenaSize bytes of the tensor arena from arenaOffset on (all of the rest when 0),
+    // replacing the model that was loaded before
+    bool loadModel(const unsigned char* modelData, size_t arenaOffset = 0, size_t arenaSize = 0);
+
+    #ifdef HIERARCHICAL_MODEL
+    // Loads the family model at the bottom of the tensor arena, where it stays for good
+    bool loadFamilyModel();
+
+    float* inferHierarchical();
+
+    // The family model, in the first family_arena_size bytes of the tensor arena. The specialists are loaded above it.
+    tflite::MicroInterpreter* family_interpreter = nullptr;
+    alignas(tflite::MicroInterpreter) uint8_t family_interpreter_buffer[sizeof(tflite::MicroInterpreter)];
+    size_t family_arena_size = 0;
+
+    // Family of the specialist model that is loaded, -1 when none is
+    int loaded_specialist = -1;
+
+    // Whether the last inference had to load another specialist model
+    bool specialist_reloaded = false;
+
+    // Reshaped model input, kept outside of the arena because both the family and the specialist model need it
+    float model_input[NUM_DATAPOINTS * NUM_LIGHT_SENSORS];
+
+    // Combined scores of the family and specialist model for all gestures
+    float hierarchical_output[NUM_FEATURES];
+    #endif // HIERARCHICAL_MODEL
+
+    #ifdef EARLY_EXIT_MODEL
+    // Loads the first stage at the bottom of the tensor arena and the second stage above it
+    bool loadEarlyExitStages();
+    float* inferEarlyExit();
+
+    // The second stage of the early exit model, the first stage is loaded in the regular interpreter
+    // and keeps the first stage_1_arena_size bytes of the tensor arena
+    tflite::MicroInterpreter* stage_2_interpreter = nullptr;
+    alignas(tflite::MicroInterpreter) uint8_t stage_2_interpreter_buffer[sizeof(tflite::MicroInterpreter)];
+    size_t stage_1_arena_size = 0;
+
+    // Index of the exit head scores in the outputs of the first stage
+    size_t exit_output_index = 0;
+    #endif // EARLY_EXIT_MODEL
 };  // class ModelWrapper
 
 #endif // MODEL_WRAPPER_HPP
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef EARLY_EXIT_MODEL_DATA_HPP
+#define EARLY_EXIT_MODEL_DATA_HPP
+
+// The stages of the early exit model, exported by export_early_exit_model in model_constructor.py
+// Stage 1: input -> [block 1 features, exit head scores]
+extern unsigned char early_exit_stage_1_tflite[];
+// Stage 2: block 1 features -> scores of the full network
+extern unsigned char early_exit_stage_2_tflite[];
+
+#endif // EARLY_EXIT_MODEL_DATA_HPP
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef GESTURES_HPP
 #define GESTURES_HPP
 
+#include <stdint.h>
+
 static const char* GESTURE_NAMES[] = {
     "swipe_left",
     "swipe_right",
@@ -14,4 +16,21 @@ static const char* GESTURE_NAMES[] = {
     "zoom_out"
 };
 
+// Gestures that look alike are grouped in families, the gestures of a family are consecutive in GESTURE_NAMES.
+// Used by the hierarchical classifier, which first picks a family and then the gesture within that family.
+#define NUM_GESTURE_FAMILIES 4
+
+static const char* GESTURE_FAMILY_NAMES[NUM_GESTURE_FAMILIES] = {
+    "swipe",
+    "circle",
+    "tap",
+    "zoom"
+};
+
+// Index in GESTURE_NAMES of the first gesture of each family
+static const uint8_t GESTURE_FAMILY_OFFSETS[NUM_GESTURE_FAMILIES] = {0, 4, 6, 8};
+
+// Number of gestures in each family
+static const uint8_t GESTURE_FAMILY_SIZES[NUM_GESTURE_FAMILIES] = {4, 2, 2, 2};
+
 #endif // GESTURES_HPP
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef HIERARCHICAL_MODEL_DATA_HPP
+#define HIERARCHICAL_MODEL_DATA_HPP
+
+#include "gestures.hpp"
+
+// The models of the hierarchical classifier, exported by export_hierarchical_models in model_constructor.py
+extern unsigned char family_model_tflite[];
+
+extern unsigned char swipe_model_tflite[];
+extern unsigned char circle_model_tflite[];
+extern unsigned char tap_model_tflite[];
+extern unsigned char zoom_model_tflite[];
+
+// Registry of specialist models, in the same order as GESTURE_FAMILY_NAMES
+static const unsigned char* const SPECIALIST_MODELS[NUM_GESTURE_FAMILIES] = {
+    swipe_model_tflite,
+    circle_model_tflite,
+    tap_model_tflite,
+    zoom_model_tflite
+};
+
+#endif // HIERARCHICAL_MODEL_DATA_HPP
\ No newline at end of file
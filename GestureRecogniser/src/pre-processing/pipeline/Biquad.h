@@ -0,0 +1,204 @@
+/**
+ * @file Biquad.h
+ * @brief A cascade of second order sections (biquads) in transposed direct form II, for float and Q15 signals.
+ *
+ */
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <stdint.h>
+
+#include "pre-processing/pipeline/Butterworth.h"
+
+/**
+ * @brief Arithmetic of the biquad cascade for a sample type.
+ *      Float signals are filtered in float. Q15 signals (int16_t) use Q2.14 coefficients, so feedback coefficients
+ *      up to +-2 fit, and keep the state in 64 bit so it cannot overflow between the samples.
+ */
+template <typename T>
+struct BiquadArithmetic;
+
+template <>
+struct BiquadArithmetic<float>
+{
+    typedef float Coefficient;
+    typedef float State;
+
+    static Coefficient FromFloat(float c) { return c; }
+    static State Multiply(Coefficient c, float x) { return c * x; }
+    static float Output(State acc) { return acc; }
+};
+
+template <>
+struct BiquadArithmetic<int16_t>
+{
+    typedef int32_t Coefficient;
+    typedef int64_t State;
+
+    static const int COEFFICIENT_BITS = 14;
+
+    static Coefficient FromFloat(float c) { return (Coefficient) (c * (1 << COEFFICIENT_BITS) + (c < 0 ? -0.5f : 0.5f)); }
+    static State Multiply(Coefficient c, int16_t x) { return (State) c * x; }
+
+    // Rounds the accumulator back to Q15 and saturates it
+    static int16_t Output(State acc)
+    {
+        acc = (acc + (1 << (COEFFICIENT_BITS - 1))) >> COEFFICIENT_BITS;
+        if (acc > INT16_MAX)
+            return INT16_MAX;
+        if (acc < INT16_MIN)
+            return INT16_MIN;
+        return (int16_t) acc;
+    }
+};
+
+/**
+ * @brief Filters CHANNELS independent signals with the same cascade of N biquads.
+ *      Every section computes, with the coefficients in the convention of BiquadCoefficients:
+ *          y[n]  = b[0] * x[n] + s1
+ *          s1    = b[1] * x[n] + a[0] * y[n] + s2
+ *          s2    = b[2] * x[n] + a[1] * y[n]
+ *      The sections are unrolled at compile time. Filter() runs a whole block, Process() one sample at a time
+ *      so the signal can be filtered while it is acquired. Both continue from the state the channel is in.
+ *
+ * @tparam T - Sample type, float or int16_t (Q15).
+ * @tparam N - Number of sections, the order of the filter is 2 * N.
+ * @tparam CHANNELS - Number of signals that are filtered, each has its own state.
+ */
+template <typename T, int N, int CHANNELS = 1>
+class Biquad
+{
+    typedef BiquadArithmetic<T> Arithmetic;
+
+public:
+    typedef typename Arithmetic::Coefficient Coefficient;
+    typedef typename Arithmetic::State State;
+
+    Biquad() { Reset(); }
+
+    /**
+     * @brief Sets the coefficients of one section, the state is kept.
+     *
+     * @param section - Index of the section, in range [0, N).
+     * @param c - Coefficients of the section, for example from Butterworth::LowPass.
+     */
+    void SetSection(int section, const BiquadCoefficients& c)
+    {
+        Coefficients& s = sections[section];
+        s.b0 = Arithmetic::FromFloat(c.b[0]);
+        s.b1 = Arithmetic::FromFloat(c.b[1]);
+        s.b2 = Arithmetic::FromFloat(c.b[2]);
+        s.a1 = Arithmetic::FromFloat(c.a[0]);
+        s.a2 = Arithmetic::FromFloat(c.a[1]);
+    }
+
+    /**
+     * @brief Clears the state of every channel.
+     */
+    void Reset()
+    {
+        for (int channel = 0; channel < CHANNELS; channel++)
+            Reset(channel);
+    }
+
+    /**
+     * @brief Clears the state of one channel, so its next sample starts a new signal.
+     */
+    void Reset(int channel)
+    {
+        for (int section = 0; section < N; section++)
+        {
+            state[channel][section][0] = 0;
+            state[channel][section][1] = 0;
+        }
+    }
+
+    /**
+     * @brief Sets the state of one section of a channel, to continue a signal that was filtered elsewhere.
+     *
+     * @param channel - Index of the channel, in range [0, CHANNELS).
+     * @param section - Index of the section, in range [0, N).
+     * @param s1 - State that is added to the next output, in the scale of the accumulator (Q29 for Q15 signals).
+     * @param s2 - State that is added to the output after that.
+     */
+    void SetState(int channel, int section, State s1, State s2)
+    {
+        state[channel][section][0] = s1;
+        state[channel][section][1] = s2;
+    }
+
+    /**
+     * @brief Filters the next sample of a channel.
+     *
+     * @param channel - Index of the channel, in range [0, CHANNELS).
+     * @param x - Input sample.
+     * @return The filtered sample.
+     */
+    T Process(int channel, T x)
+    {
+        return Cascade<0>::Run(sections, state[channel], x);
+    }
+
+    /**
+     * @brief Filters a block of samples of a channel in place.
+     *
+     * @param channel - Index of the channel, in range [0, CHANNELS).
+     * @param signal - Samples to filter, overwritten with the output.
+     * @param length - Number of samples.
+     */
+    void Filter(int channel, T* signal, int length)
+    {
+        State (&s)[N][2] = state[channel];
+        for (int n = 0; n < length; n++)
+            signal[n] = Cascade<0>::Run(sections, s, signal[n]);
+    }
+
+    /**
+     * @brief Filters a block of interleaved samples of all channels in place, one frame (a sample of every channel)
+     *      after the other. The recurrences of the channels do not depend on each other, so the FPU can overlap them.
+     *
+     * @param frames - Samples to filter, CHANNELS per frame, overwritten with the output.
+     * @param length - Number of frames.
+     */
+    void FilterInterleaved(T* frames, int length)
+    {
+        for (int n = 0; n < length; n++, frames += CHANNELS)
+        {
+            for (int channel = 0; channel < CHANNELS; channel++)
+                frames[channel] = Cascade<0>::Run(sections, state[channel], frames[channel]);
+        }
+    }
+
+private:
+    struct Coefficients
+    {
+        Coefficient b0, b1, b2, a1, a2;
+    };
+
+    // Runs section I and then the sections after it, the recursion ends at section N
+    template <int I, bool END = (I == N)>
+    struct Cascade
+    {
+        static T Run(const Coefficients (&c)[N], State (&s)[N][2], T x)
+        {
+            State acc = Arithmetic::Multiply(c[I].b0, x) + s[I][0];
+            T y = Arithmetic::Output(acc);
+
+            s[I][0] = Arithmetic::Multiply(c[I].b1, x) + Arithmetic::Multiply(c[I].a1, y) + s[I][1];
+            s[I][1] = Arithmetic::Multiply(c[I].b2, x) + Arithmetic::Multiply(c[I].a2, y);
+
+            return Cascade<I + 1>::Run(c, s, y);
+        }
+    };
+
+    template <int I>
+    struct Cascade<I, true>
+    {
+        static T Run(const Coefficients (&)[N], State (&)[N][2], T x) { return x; }
+    };
+
+    Coefficients sections[N] = {};
+    State state[CHANNELS][N][2];
+};
+
+#endif // BIQUAD_H
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**
+ * @file Butterworth.h
+ * @brief Design of Butterworth filter coefficients for a sample rate and cutoff frequency that are known at runtime.
+ *
+ */
+#ifndef BUTTERWORTH_H
+#define BUTTERWORTH_H
+
+#include <math.h>
+
+/**
+ * @brief Coefficients of a second order (biquad) filter.
+ *      y[n] = a[0] * y[n-1] + a[1] * y[n-2] + b[0] * x[n] + b[1] * x[n-1] + b[2] * x[n-2]
+ *      Note that the feedback coefficients a have the opposite sign of the usual 1 + a1 z^-1 + a2 z^-2 notation.
+ */
+struct BiquadCoefficients
+{
+    float a[2];
+    float b[3];
+};
+
+/**
+ * @brief Designs Butterworth filters on the device, so the sample rate and cutoff can be chosen at runtime.
+ *
+ * Same design as https://github.com/curiores/ArduinoTutorials/blob/main/BasicFilters/Design/LowPass/ButterworthFilter.ipynb
+ * and butterworth_coefficients in Model/data_processing.py: the analog prototype is mapped with the bilinear
+ * transform s = 2 * fs * (1 - z^-1) / (1 + z^-1), without prewarping the cutoff frequency.
+ */
+class Butterworth
+{
+
+public:
+    /**
+     * @brief Computes the coefficients of a 2nd order Butterworth low pass filter.
+     *      For a sample rate of 100 Hz and a cutoff of 25 Hz these are a = {0.28094574, -0.18556054}
+     *      and b = {0.2261537, 0.4523074, 0.2261537}.
+     *
+     * @param sampleRate - Sample rate of the signal in Hz.
+     * @param cutoff - Cutoff frequency in Hz, expected to be in range (0, sampleRate / 2).
+     * @return The coefficients of the filter.
+     */
+    static BiquadCoefficients LowPass(float sampleRate, float cutoff)
+    {
+        // Analog prototype H(s) = wc^2 / (s^2 + sqrt(2) * wc * s + wc^2)
+        const float wc = 2.0f * (float) M_PI * cutoff;
+        const float k = 2.0f * sampleRate;
+
+        const float wc2 = wc * wc;
+        const float k2 = k * k;
+        const float damping = (float) M_SQRT2 * wc * k;
+
+        // Substituting s = k * (1 - z^-1) / (1 + z^-1) and dividing everything by the constant of the denominator
+        const float norm = 1.0f / (k2 + damping + wc2);
+
+        BiquadCoefficients c;
+        c.b[0] = wc2 * norm;
+        c.b[1] = 2.0f * c.b[0];
+        c.b[2] = c.b[0];
+
+        c.a[0] = 2.0f * (k2 - wc2) * norm;
+        c.a[1] = -(k2 - damping + wc2) * norm;
+
+        return c;
+    }
+
+    /**
+     * @brief Computes the coefficients of a 2nd order Butterworth high pass filter, the complement of LowPass.
+     *
+     * @param sampleRate - Sample rate of the signal in Hz.
+     * @param cutoff - Cutoff frequency in Hz, expected to be in range (0, sampleRate / 2).
+     * @return The coefficients of the filter.
+     */
+    static BiquadCoefficients HighPass(float sampleRate, float cutoff)
+    {
+        // Analog prototype H(s) = s^2 / (s^2 + sqrt(2) * wc * s + wc^2), the poles are the same as those of the low pass
+        BiquadCoefficients c = LowPass(sampleRate, cutoff);
+
+        const float k = 2.0f * sampleRate;
+        const float wc = 2.0f * (float) M_PI * cutoff;
+        const float norm = 1.0f / (k * k + (float) M_SQRT2 * wc * k + wc * wc);
+
+        c.b[0] = k * k * norm;
+        c.b[1] = -2.0f * c.b[0];
+        c.b[2] = c.b[0];
+
+        return c;
+    }
+};
+
+#endif // BUTTERWORTH_H
\ No newline at end of file
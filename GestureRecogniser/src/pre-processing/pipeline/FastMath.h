@@ -0,0 +1,41 @@
+/**
+ * @file FastMath.h
+ * @brief Division free math for the pre-processing. On the Cortex-M4F a float divide or square root takes
+ *      14 cycles, a multiply or multiply-add only 1 to 3, so divides per sample are replaced by a multiply with a reciprocal.
+ *      The loops that apply them are in Kernels.h.
+ *
+ */
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <stdint.h>
+#include <string.h>
+
+class FastMath
+{
+
+public:
+    /**
+     * @brief Approximates 1 / sqrt(x) with the exponent trick and two Newton-Raphson steps,
+     *      the relative error is below 5e-6.
+     *
+     * @param x - Positive input.
+     * @return The reciprocal square root of x.
+     */
+    static float Rsqrt(float x)
+    {
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        bits = 0x5F375A86 - (bits >> 1);
+
+        float y;
+        memcpy(&y, &bits, sizeof(y));
+
+        const float halfX = 0.5f * x;
+        y = y * (1.5f - halfX * y * y);
+        y = y * (1.5f - halfX * y * y);
+        return y;
+    }
+};
+
+#endif // FAST_MATH_H
\ No newline at end of file
@@ -0,0 +1,377 @@
+/**
+ * @file Kernels.h
+ * @brief The loops of the pre-processing, vectorised where the processor supports it.
+ *      On the Cortex-M4 the DSP extension adds and multiplies two 16 bit samples at once, on the host SSE2 works
+ *      on 8 samples at once. Define SCALAR_KERNELS to always use the scalar versions.
+ *
+ */
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(SCALAR_KERNELS) && defined(__ARM_FEATURE_DSP)
+#define KERNELS_ARM_DSP
+#include <cmsis_compiler.h>
+#elif !defined(SCALAR_KERNELS) && defined(__SSE2__)
+#define KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief The plain loops, used where no vector instructions are available, and as reference for the vectorised kernels.
+ */
+class ScalarKernels
+{
+
+public:
+    /**
+     * @brief Converts samples to floats.
+     */
+    static void ToFloat(const uint16_t *input, float *output, int length)
+    {
+        for (int i = 0; i < length; i++)
+            output[i] = (float) input[i];
+    }
+
+    /**
+     * @brief The largest value of a signal, at least 0.
+     */
+    static float Max(const float *signal, int length)
+    {
+        float max = 0;
+        for (int i = 0; i < length; i++)
+        {
+            if (signal[i] > max)
+                max = signal[i];
+        }
+        return max;
+    }
+
+    /**
+     * @brief The maximum, sum and sum of squares of samples below 32768, in one pass.
+     *      The sum of squares wraps around at 32 bit, the caller makes sure it fits.
+     */
+    static void Statistics(const uint16_t *input, int length, uint16_t &max, uint32_t &sum, uint32_t &sumSquares)
+    {
+        max = 0;
+        sum = 0;
+        sumSquares = 0;
+        for (int i = 0; i < length; i++)
+        {
+            uint16_t x = input[i];
+            if (x > max)
+                max = x;
+            sum += x;
+            sumSquares += (uint32_t) x * x;
+        }
+    }
+
+    /**
+     * @brief Converts samples to floats with one multiply-add per sample: output = input * gain + offset.
+     *      The output may not overlap the input.
+     */
+    static void Affine(const uint16_t *input, float *output, int length, float gain, float offset)
+    {
+        for (int i = 0; i < length; i++)
+            output[i] = input[i] * gain + offset;
+    }
+
+    /**
+     * @brief Statistics of every channel of interleaved samples, length frames of CHANNELS samples each.
+     */
+    template <size_t CHANNELS>
+    static void StatisticsInterleaved(const uint16_t *input, int length, uint16_t (&max)[CHANNELS], uint32_t (&sum)[CHANNELS], uint32_t (&sumSquares)[CHANNELS])
+    {
+        for (size_t c = 0; c < CHANNELS; c++)
+        {
+            max[c] = 0;
+            sum[c] = 0;
+            sumSquares[c] = 0;
+        }
+
+        for (int i = 0; i < length; i++, input += CHANNELS)
+        {
+            for (size_t c = 0; c < CHANNELS; c++)
+            {
+                uint16_t x = input[c];
+                if (x > max[c])
+                    max[c] = x;
+                sum[c] += x;
+                sumSquares[c] += (uint32_t) x * x;
+            }
+        }
+    }
+
+    /**
+     * @brief Affine for interleaved samples, with a gain per channel.
+     */
+    template <size_t CHANNELS>
+    static void AffineInterleaved(const uint16_t *input, float *output, int length, const float (&gain)[CHANNELS], float offset)
+    {
+        for (int i = 0; i < length; i++, input += CHANNELS, output += CHANNELS)
+        {
+            for (size_t c = 0; c < CHANNELS; c++)
+                output[c] = input[c] * gain[c] + offset;
+        }
+    }
+};
+
+/**
+ * @brief The kernels of the pre-processing, with the same interface and results as ScalarKernels.
+ *      The integer results are exact. The float results are the same up to rounding, within 1 ulp
+ *      when the compiler contracts the scalar multiply-add into a fused one.
+ */
+class Kernels
+{
+
+public:
+    static const char *Name()
+    {
+        #if defined(KERNELS_ARM_DSP)
+        return "ARM DSP";
+        #elif defined(KERNELS_SSE2)
+        return "SSE2";
+        #else
+        return "scalar";
+        #endif
+    }
+
+    static void ToFloat(const uint16_t *input, float *output, int length)
+    {
+        #if defined(KERNELS_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *) (input + i));
+            _mm_storeu_ps(output + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)));
+            _mm_storeu_ps(output + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)));
+        }
+        ScalarKernels::ToFloat(input + i, output + i, length - i);
+        #else
+        // The FPU of the Cortex-M4 converts one value at a time
+        ScalarKernels::ToFloat(input, output, length);
+        #endif
+    }
+
+    static float Max(const float *signal, int length)
+    {
+        #if defined(KERNELS_SSE2)
+        __m128 max = _mm_setzero_ps();
+        int i = 0;
+        for (; i + 4 <= length; i += 4)
+            max = _mm_max_ps(max, _mm_loadu_ps(signal + i));
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, max);
+        float result = ScalarKernels::Max(signal + i, length - i);
+        for (int j = 0; j < 4; j++)
+        {
+            if (lanes[j] > result)
+                result = lanes[j];
+        }
+        return result;
+        #else
+        return ScalarKernels::Max(signal, length);
+        #endif
+    }
+
+    static void Statistics(const uint16_t *input, int length, uint16_t &max, uint32_t &sum, uint32_t &sumSquares)
+    {
+        #if defined(KERNELS_ARM_DSP)
+        // Two samples per 32 bit word. SMLAD multiplies both halves and adds both products to the accumulator.
+        // The maximum of both halves is max + saturate(x - max) with UQSUB16 and UADD16, which doesn't depend on the
+        // GE flags that the compiler may not keep between two intrinsics.
+        uint32_t packedMax = 0;
+        uint32_t packedSum = 0;
+        uint32_t packedSquares = 0;
+        int i = 0;
+        for (; i + 2 <= length; i += 2)
+        {
+            uint32_t x;
+            memcpy(&x, input + i, sizeof(x));
+
+            packedSum = __SMLAD(x, 0x00010001, packedSum);
+            packedSquares = __SMLAD(x, x, packedSquares);
+
+            packedMax = __UADD16(packedMax, __UQSUB16(x, packedMax));
+        }
+
+        ScalarKernels::Statistics(input + i, length - i, max, sum, sumSquares);
+        sum += packedSum;
+        sumSquares += packedSquares;
+
+        uint16_t low = packedMax & 0xFFFF;
+        uint16_t high = packedMax >> 16;
+        if (low > max)
+            max = low;
+        if (high > max)
+            max = high;
+        #elif defined(KERNELS_SSE2)
+        // PMADDWD multiplies 16 bit samples and adds neighbouring products into 32 bit lanes.
+        // SSE2 only has a signed 16 bit maximum, so the samples are shifted into the signed range for it.
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i bias = _mm_set1_epi16((short) 0x8000);
+        __m128i packedMax = bias;
+        __m128i packedSum = _mm_setzero_si128();
+        __m128i packedSquares = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *) (input + i));
+
+            packedSum = _mm_add_epi32(packedSum, _mm_madd_epi16(x, ones));
+            packedSquares = _mm_add_epi32(packedSquares, _mm_madd_epi16(x, x));
+            packedMax = _mm_max_epi16(packedMax, _mm_xor_si128(x, bias));
+        }
+
+        ScalarKernels::Statistics(input + i, length - i, max, sum, sumSquares);
+
+        uint32_t sums[4];
+        uint32_t squares[4];
+        uint16_t maxima[8];
+        _mm_storeu_si128((__m128i *) sums, packedSum);
+        _mm_storeu_si128((__m128i *) squares, packedSquares);
+        _mm_storeu_si128((__m128i *) maxima, _mm_xor_si128(packedMax, bias));
+
+        for (int j = 0; j < 4; j++)
+        {
+            sum += sums[j];
+            sumSquares += squares[j];
+        }
+        for (int j = 0; j < 8; j++)
+        {
+            if (maxima[j] > max)
+                max = maxima[j];
+        }
+        #else
+        ScalarKernels::Statistics(input, length, max, sum, sumSquares);
+        #endif
+    }
+
+    static void Affine(const uint16_t *input, float *output, int length, float gain, float offset)
+    {
+        #if defined(KERNELS_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 g = _mm_set1_ps(gain);
+        const __m128 o = _mm_set1_ps(offset);
+        int i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *) (input + i));
+            __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero));
+            __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero));
+            _mm_storeu_ps(output + i, _mm_add_ps(_mm_mul_ps(low, g), o));
+            _mm_storeu_ps(output + i + 4, _mm_add_ps(_mm_mul_ps(high, g), o));
+        }
+        ScalarKernels::Affine(input + i, output + i, length - i, gain, offset);
+        #else
+        // The Cortex-M4 has no float vector instructions, the scalar loop compiles to one VFMA per sample
+        ScalarKernels::Affine(input, output, length, gain, offset);
+        #endif
+    }
+
+    template <size_t CHANNELS>
+    static void StatisticsInterleaved(const uint16_t *input, int length, uint16_t (&max)[CHANNELS], uint32_t (&sum)[CHANNELS], uint32_t (&sumSquares)[CHANNELS])
+    {
+        #if defined(KERNELS_SSE2)
+        // A block of 8 frames is CHANNELS vectors of 8 samples, and every lane of those always holds the same channel.
+        // PMADDWD would add the samples of two channels, so the squares are widened with PMULLW and PMULHUW instead.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16((short) 0x8000);
+        __m128i packedMax[CHANNELS];
+        __m128i packedSum[2 * CHANNELS];
+        __m128i packedSquares[2 * CHANNELS];
+        for (size_t v = 0; v < CHANNELS; v++)
+        {
+            packedMax[v] = bias;
+            packedSum[2 * v] = packedSum[2 * v + 1] = zero;
+            packedSquares[2 * v] = packedSquares[2 * v + 1] = zero;
+        }
+
+        int i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            const uint16_t *block = input + i * CHANNELS;
+            for (size_t v = 0; v < CHANNELS; v++)
+            {
+                __m128i x = _mm_loadu_si128((const __m128i *) (block + 8 * v));
+                __m128i low = _mm_mullo_epi16(x, x);
+                __m128i high = _mm_mulhi_epu16(x, x);
+
+                packedSum[2 * v] = _mm_add_epi32(packedSum[2 * v], _mm_unpacklo_epi16(x, zero));
+                packedSum[2 * v + 1] = _mm_add_epi32(packedSum[2 * v + 1], _mm_unpackhi_epi16(x, zero));
+                packedSquares[2 * v] = _mm_add_epi32(packedSquares[2 * v], _mm_unpacklo_epi16(low, high));
+                packedSquares[2 * v + 1] = _mm_add_epi32(packedSquares[2 * v + 1], _mm_unpackhi_epi16(low, high));
+                packedMax[v] = _mm_max_epi16(packedMax[v], _mm_xor_si128(x, bias));
+            }
+        }
+
+        ScalarKernels::StatisticsInterleaved(input + i * CHANNELS, length - i, max, sum, sumSquares);
+
+        for (size_t v = 0; v < CHANNELS; v++)
+        {
+            uint32_t sums[8];
+            uint32_t squares[8];
+            uint16_t maxima[8];
+            _mm_storeu_si128((__m128i *) sums, packedSum[2 * v]);
+            _mm_storeu_si128((__m128i *) (sums + 4), packedSum[2 * v + 1]);
+            _mm_storeu_si128((__m128i *) squares, packedSquares[2 * v]);
+            _mm_storeu_si128((__m128i *) (squares + 4), packedSquares[2 * v + 1]);
+            _mm_storeu_si128((__m128i *) maxima, _mm_xor_si128(packedMax[v], bias));
+
+            for (size_t j = 0; j < 8; j++)
+            {
+                size_t c = (8 * v + j) % CHANNELS;
+                sum[c] += sums[j];
+                sumSquares[c] += squares[j];
+                if (maxima[j] > max[c])
+                    max[c] = maxima[j];
+            }
+        }
+        #else
+        // The halves of a 32 bit word hold two channels, which the dual 16 bit instructions of the Cortex-M4 would add
+        // together, so the interleaved samples take the plain loop
+        ScalarKernels::StatisticsInterleaved(input, length, max, sum, sumSquares);
+        #endif
+    }
+
+    template <size_t CHANNELS>
+    static void AffineInterleaved(const uint16_t *input, float *output, int length, const float (&gain)[CHANNELS], float offset)
+    {
+        #if defined(KERNELS_SSE2)
+        // A block of 8 frames is 2 * CHANNELS vectors of 4 floats, the gains repeat in the same pattern
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 o = _mm_set1_ps(offset);
+        __m128 g[2 * CHANNELS];
+        for (size_t h = 0; h < 2 * CHANNELS; h++)
+        {
+            g[h] = _mm_setr_ps(gain[(4 * h) % CHANNELS], gain[(4 * h + 1) % CHANNELS],
+                               gain[(4 * h + 2) % CHANNELS], gain[(4 * h + 3) % CHANNELS]);
+        }
+
+        int i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            const uint16_t *block = input + i * CHANNELS;
+            float *out = output + i * CHANNELS;
+            for (size_t v = 0; v < CHANNELS; v++)
+            {
+                __m128i x = _mm_loadu_si128((const __m128i *) (block + 8 * v));
+                __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero));
+                __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero));
+                _mm_storeu_ps(out + 8 * v, _mm_add_ps(_mm_mul_ps(low, g[2 * v]), o));
+                _mm_storeu_ps(out + 8 * v + 4, _mm_add_ps(_mm_mul_ps(high, g[2 * v + 1]), o));
+            }
+        }
+        ScalarKernels::AffineInterleaved(input + i * CHANNELS, output + i * CHANNELS, length - i, gain, offset);
+        #else
+        ScalarKernels::AffineInterleaved(input, output, length, gain, offset);
+        #endif
+    }
+};
+
+#endif // KERNELS_H
\ No newline at end of file
@@ -0,0 +1,71 @@
+/**
+ * @file Layout.h
+ * @brief The order in which the samples of several channels are stored in a buffer.
+ *
+ */
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief All samples of the first channel, then all samples of the second channel, and so on: T[CHANNELS][LENGTH].
+ *      Every channel is a signal in one piece.
+ */
+template <size_t C, size_t L>
+struct PlanarLayout
+{
+    static const size_t CHANNELS = C;
+    static const size_t LENGTH = L;
+    static const bool INTERLEAVED = false;
+
+    // Distance between two samples of a channel
+    static const size_t STRIDE = 1;
+
+    template <typename T>
+    using Buffer = T[CHANNELS][LENGTH];
+
+    typedef Buffer<uint16_t> Raw;
+    typedef Buffer<float> Signal;
+
+    /**
+     * @brief Sample n of a channel.
+     */
+    template <typename T>
+    static T& At(Buffer<T>& buffer, size_t channel, size_t n) { return buffer[channel][n]; }
+
+    /**
+     * @brief The first sample of a channel, the next samples of the channel follow every STRIDE elements.
+     */
+    template <typename T>
+    static T* Channel(Buffer<T>& buffer, size_t channel) { return &buffer[channel][0]; }
+};
+
+/**
+ * @brief One sample of every channel (a frame), then the next frame, and so on: T[LENGTH][CHANNELS].
+ *      This is the time major order of the model input, and the order in which the samples are acquired.
+ */
+template <size_t C, size_t L>
+struct InterleavedLayout
+{
+    static const size_t CHANNELS = C;
+    static const size_t LENGTH = L;
+    static const bool INTERLEAVED = true;
+
+    static const size_t STRIDE = CHANNELS;
+
+    template <typename T>
+    using Buffer = T[LENGTH][CHANNELS];
+
+    typedef Buffer<uint16_t> Raw;
+    typedef Buffer<float> Signal;
+
+    template <typename T>
+    static T& At(Buffer<T>& buffer, size_t channel, size_t n) { return buffer[n][channel]; }
+
+    template <typename T>
+    static T* Channel(Buffer<T>& buffer, size_t channel) { return &buffer[0][channel]; }
+};
+
+#endif // LAYOUT_H
\ No newline at end of file
@@ -6,6 +6,8 @@
  * Modified from: https://github.com/StijnW66/CSE3000-Gesture-Recognition/blob/e6f01a54d494be49a5eebb90f43460f3c43adf4f/src/receiver/pipeline-stages/MaxNormaliser.h
  *
  */
+#include "pre-processing/pipeline/Kernels.h"
+
 class MaxNormaliser
 {
 
@@ -18,29 +20,43 @@ public:
      *
      * @param signal - Input signal to normalise. Expected to be in range [0, MAXIMUM].
      * @param length - Length of input signal.
+     * @param stride - Distance between two samples of the signal, for a signal that is interleaved with others.
      */
-    void Normalise(float *signal, int length)
+    void Normalise(float *signal, int length, int stride = 1)
     {
-        // Compute max
-        int index = 0;
-        float max = 0;
-        while (index < length)
+        if (stride != 1)
         {
-            if (signal[index] > max)
-                max = signal[index];
-            index++;
+            NormaliseStrided(signal, length, stride);
+            return;
         }
 
+        // Compute max
+        float max = Kernels::Max(signal, length);
+
         if (max == 0)
             return;
 
-        index = 0;
-        
-        // Normalise
-        while (index < length)
+        // Normalise. This is the reference of Model/data_processing.py, so it keeps the divide per sample,
+        // the fast pipeline folds the normalisation into Standardise instead.
+        for (int i = 0; i < length; i++)
+            signal[i] /= max;
+    }
+
+private:
+    // The kernels need the samples in one piece, the same steps in plain loops
+    void NormaliseStrided(float *signal, int length, int stride)
+    {
+        float max = 0;
+        for (int i = 0; i < length * stride; i += stride)
         {
-            signal[index] /= max;
-            index++;
+            if (signal[i] > max)
+                max = signal[i];
         }
+
+        if (max == 0)
+            return;
+
+        for (int i = 0; i < length * stride; i += stride)
+            signal[i] /= max;
     }
 };
\ No newline at end of file
@@ -0,0 +1,86 @@
+/**
+ * @file Pipeline.h
+ * @brief A pre-processing pipeline that is composed of stages at compile time.
+ *
+ */
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pre-processing/pipeline/Layout.h"
+
+template <int I>
+struct PipelineIndex {};
+
+/**
+ * @brief Runs a list of stages over a capture, in the order they are listed, for example
+ *      Pipeline<ToFloat, MaxNormalise, ZScore, ModelLowPass<NUM_LIGHT_SENSORS>>.
+ *      The stages are members and are called directly, without virtual functions, so the compiler can inline
+ *      all of them into Run. Swapping a stage only changes the type of the pipeline.
+ *
+ *      The pipeline runs on buffers of any Layout (see Layout.h), which is passed to every stage.
+ *      The first stage loads the raw samples, it has a member
+ *          template <typename Layout> void Load(const typename Layout::Raw& raw, typename Layout::Signal& signal)
+ *      The other stages work on the loaded signal in place, they have a member
+ *          template <typename Layout> void Apply(typename Layout::Signal& signal)
+ */
+template <typename... Stages>
+class Pipeline;
+
+template <>
+class Pipeline<>
+{
+
+public:
+    template <typename Layout>
+    void Apply(typename Layout::Signal&) {}
+};
+
+template <typename First, typename... Rest>
+class Pipeline<First, Rest...>
+{
+
+public:
+    /**
+     * @brief Loads the raw samples with the first stage and applies the other stages to them.
+     *
+     * @tparam Layout - Layout of the raw samples and of the output, for example PlanarLayout<CHANNELS, LENGTH>.
+     * @param raw - Raw samples of every channel, LENGTH each.
+     * @param signal - Output of the pipeline.
+     */
+    template <typename Layout>
+    void Run(const typename Layout::Raw& raw, typename Layout::Signal& signal)
+    {
+        first.template Load<Layout>(raw, signal);
+        rest.template Apply<Layout>(signal);
+    }
+
+    /**
+     * @brief Applies all stages to a signal that is already loaded.
+     */
+    template <typename Layout>
+    void Apply(typename Layout::Signal& signal)
+    {
+        first.template Apply<Layout>(signal);
+        rest.template Apply<Layout>(signal);
+    }
+
+    /**
+     * @brief The stage at index I, to configure it.
+     */
+    template <int I>
+    auto& GetStage() { return Stage(PipelineIndex<I>()); }
+
+    First& Stage(PipelineIndex<0>) { return first; }
+
+    template <int I>
+    auto& Stage(PipelineIndex<I>) { return rest.Stage(PipelineIndex<I - 1>()); }
+
+private:
+    First first;
+    Pipeline<Rest...> rest;
+};
+
+#endif // PIPELINE_H
\ No newline at end of file
@@ -0,0 +1,151 @@
+/**
+ * @file Resampler.h
+ * @brief A class that maps a signal of any length onto a signal of another length, using integer arithmetic only.
+ *
+ */
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <math.h>
+
+class Resampler
+{
+
+public:
+    enum Mode
+    {
+        // Linear interpolation between the two nearest input samples
+        LINEAR,
+        // Windowed sinc interpolation over TAPS input samples, band limited when the signal is shortened
+        POLYPHASE
+    };
+
+    // Number of input samples per output sample and number of fractional positions of the polyphase filter
+    static const int TAPS = 8;
+    static const int PHASES = 32;
+
+    Resampler(Mode mode = LINEAR) : mode(mode) {}
+
+    /**
+     * @brief Resamples a signal so that its first and last samples line up with the first and last output samples.
+     *      The position in the input is kept in a 16.16 fixed point phase accumulator. The part of the step below the
+     *      16.16 resolution is carried over, so the last output lands exactly on the last input.
+     *
+     * @param input - Input signal.
+     * @param inputLength - Length of the input signal, at least 1.
+     * @param output - Output signal, may not overlap with the input.
+     * @param outputLength - Length of the output signal, at least 2.
+     */
+    void Resample(const uint16_t *input, int inputLength, uint16_t *output, int outputLength)
+    {
+        if (inputLength != configuredInputLength || outputLength != configuredOutputLength)
+            Configure(inputLength, outputLength);
+
+        uint32_t position = 0;
+        uint32_t carry = 0;
+        for (int j = 0; j < outputLength; j++)
+        {
+            int index = position >> 16;
+            uint32_t fraction = position & 0xFFFF;
+
+            if (mode == LINEAR)
+            {
+                if (index + 1 >= inputLength)
+                {
+                    output[j] = input[inputLength - 1];
+                }
+                else
+                {
+                    // A difference beyond 15 bits times a 16 bit fraction does not fit in 32 bits
+                    int64_t difference = (int64_t)input[index + 1] - input[index];
+                    output[j] = input[index] + (int32_t)((difference * fraction) >> 16);
+                }
+            }
+            else
+            {
+                const int16_t *phase = coefficients[fraction >> (16 - PHASE_BITS)];
+
+                // Taps that fall outside of the input repeat the first or last sample
+                int32_t accumulator = 0;
+                for (int k = 0; k < TAPS; k++)
+                {
+                    int n = index - TAPS / 2 + 1 + k;
+                    n = n < 0 ? 0 : (n >= inputLength ? inputLength - 1 : n);
+                    accumulator += (int32_t)phase[k] * input[n];
+                }
+
+                accumulator = (accumulator + (1 << 13)) >> 14;
+                output[j] = accumulator < 0 ? 0 : (accumulator > UINT16_MAX ? UINT16_MAX : accumulator);
+            }
+
+            position += step;
+            carry += stepRemainder;
+            if (carry >= (uint32_t)(outputLength - 1))
+            {
+                carry -= outputLength - 1;
+                position++;
+            }
+        }
+    }
+
+private:
+    static const int PHASE_BITS = 5;
+    static_assert(1 << PHASE_BITS == PHASES, "PHASES must be a power of two");
+
+    Mode mode;
+
+    int configuredInputLength = 0;
+    int configuredOutputLength = 0;
+    uint32_t step = 0;
+    uint32_t stepRemainder = 0;
+
+    // Q14 filter coefficients of every phase, every phase sums to exactly 1.
+    // Q14 leaves room for the single tap of 1 at the phase without a fraction.
+    int16_t coefficients[PHASES][TAPS];
+
+    void Configure(int inputLength, int outputLength)
+    {
+        configuredInputLength = inputLength;
+        configuredOutputLength = outputLength;
+        step = ((uint32_t)(inputLength - 1) << 16) / (outputLength - 1);
+        stepRemainder = ((uint32_t)(inputLength - 1) << 16) % (outputLength - 1);
+
+        if (mode != POLYPHASE)
+            return;
+
+        // When the signal is shortened the cutoff frequency moves down with it to prevent aliasing
+        float cutoff = inputLength > outputLength ? (float)(outputLength - 1) / (inputLength - 1) : 1.0f;
+
+        for (int p = 0; p < PHASES; p++)
+        {
+            float taps[TAPS];
+            float sum = 0;
+            for (int k = 0; k < TAPS; k++)
+            {
+                // Distance between the input sample of the tap and the output position
+                float distance = k - (TAPS / 2 - 1) - (float)p / PHASES;
+                float x = M_PI * cutoff * distance;
+                float sinc = x == 0 ? 1.0f : sin(x) / x;
+                float window = 0.5f * (1 + cos(M_PI * distance / (TAPS / 2)));
+
+                taps[k] = sinc * window;
+                sum += taps[k];
+            }
+
+            // Quantise and put the rounding error on the largest tap, so a constant signal stays constant
+            int32_t total = 0;
+            int largest = 0;
+            for (int k = 0; k < TAPS; k++)
+            {
+                coefficients[p][k] = (int16_t)lroundf(taps[k] / sum * 16384);
+                total += coefficients[p][k];
+                if (taps[k] > taps[largest])
+                    largest = k;
+            }
+            coefficients[p][largest] += 16384 - total;
+        }
+    }
+};
+
+#endif // RESAMPLER_H
\ No newline at end of file
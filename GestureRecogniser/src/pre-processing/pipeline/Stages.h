@@ -0,0 +1,281 @@
+/**
+ * @file Stages.h
+ * @brief The stages of the pre-processing pipeline, see Pipeline.h.
+ *
+ */
+#ifndef STAGES_H
+#define STAGES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "pre-processing/pipeline/MaxNormaliser.h"
+#include "pre-processing/pipeline/FastMath.h"
+#include "pre-processing/pipeline/Kernels.h"
+#include "pre-processing/pipeline/Biquad.h"
+#include "pre-processing/pipeline/Layout.h"
+
+/**
+ * @brief Loads the raw samples as floats.
+ */
+class ToFloat
+{
+
+public:
+    template <typename Layout>
+    void Load(const typename Layout::Raw& raw, typename Layout::Signal& signal)
+    {
+        // The conversion does not depend on the order of the samples
+        Kernels::ToFloat(&raw[0][0], &signal[0][0], Layout::CHANNELS * Layout::LENGTH);
+    }
+};
+
+/**
+ * @brief Divides every channel by its maximum.
+ */
+class MaxNormalise
+{
+
+public:
+    template <typename Layout>
+    void Apply(typename Layout::Signal& signal)
+    {
+        for (size_t i = 0; i < Layout::CHANNELS; i++)
+            maxNormaliser.Normalise(Layout::Channel(signal, i), Layout::LENGTH, Layout::STRIDE);
+    }
+
+private:
+    MaxNormaliser maxNormaliser;
+};
+
+/**
+ * @brief Removes the mean of all channels together and divides by their standard deviation.
+ */
+class ZScore
+{
+
+public:
+    template <typename Layout>
+    void Apply(typename Layout::Signal& signal)
+    {
+        const size_t CHANNELS = Layout::CHANNELS;
+        const size_t LENGTH = Layout::LENGTH;
+
+        // Summed channel after channel in every layout, so the reference gives the same result for all of them
+        float mean = 0;
+        for (size_t i = 0; i < CHANNELS; i++)
+        {
+            for (size_t j = 0; j < LENGTH; j++)
+                mean += Layout::At(signal, i, j);
+        }
+        mean /= (CHANNELS * LENGTH);
+
+        float std = 0;
+        for (size_t i = 0; i < CHANNELS; i++)
+        {
+            for (size_t j = 0; j < LENGTH; j++)
+            {
+                float& x = Layout::At(signal, i, j);
+                x -= mean;
+                std += x * x;
+            }
+        }
+        std /= (CHANNELS * LENGTH);
+        std = sqrt(std);
+
+        for (size_t i = 0; i < CHANNELS; i++)
+        {
+            for (size_t j = 0; j < LENGTH; j++)
+                Layout::At(signal, i, j) /= std;
+        }
+    }
+};
+
+/**
+ * @brief Loads the raw samples already divided by the maximum of their channel and z-scored, the same result as
+ *      ToFloat, MaxNormalise and ZScore after each other. Exact integer statistics of the raw samples give the gain
+ *      and offset, after which every sample takes one multiply-add and no divide.
+ *      The samples must be below 32768, and the sums of squares are 32 bit, so LENGTH times the square of the largest
+ *      sample must fit (it does for 100 ADC readings).
+ */
+class Standardise
+{
+
+public:
+    template <typename Layout>
+    void Load(const typename Layout::Raw& raw, typename Layout::Signal& signal)
+    {
+        const size_t CHANNELS = Layout::CHANNELS;
+        const size_t LENGTH = Layout::LENGTH;
+
+        // One pass over the raw samples for the statistics of every channel
+        uint16_t max[CHANNELS];
+        uint32_t sum[CHANNELS];
+        uint32_t sumSquares[CHANNELS];
+        if (Layout::INTERLEAVED)
+            Kernels::StatisticsInterleaved(&raw[0][0], LENGTH, max, sum, sumSquares);
+        else
+        {
+            for (size_t i = 0; i < CHANNELS; i++)
+                Kernels::Statistics(Layout::Channel(raw, i), LENGTH, max[i], sum[i], sumSquares[i]);
+        }
+
+        float gain[CHANNELS];
+        float offset;
+        Compute<CHANNELS, LENGTH>(max, sum, sumSquares, gain, offset);
+
+        // And one pass that converts, normalises and standardises the samples together
+        if (Layout::INTERLEAVED)
+            Kernels::AffineInterleaved(&raw[0][0], &signal[0][0], LENGTH, gain, -offset);
+        else
+        {
+            for (size_t i = 0; i < CHANNELS; i++)
+                Kernels::Affine(Layout::Channel(raw, i), Layout::Channel(signal, i), LENGTH, gain[i], -offset);
+        }
+    }
+
+    /**
+     * @brief Turns the maximum, sum and sum of squares of the raw samples of every channel into the gain of every
+     *      channel and the offset, so that x * gain - offset is x divided by the maximum of its channel, minus the
+     *      mean of all channels, divided by their standard deviation.
+     */
+    template <size_t CHANNELS, size_t LENGTH>
+    static void Compute(const uint16_t (&max)[CHANNELS], const uint32_t (&sum)[CHANNELS], const uint32_t (&sumSquares)[CHANNELS],
+                        float (&gain)[CHANNELS], float& offset)
+    {
+        const float invLength = 1.0f / LENGTH;
+
+        // Statistics of each channel after dividing it by its maximum
+        float scale[CHANNELS];
+        float channelMean[CHANNELS];
+        float mean = 0;
+        for (size_t i = 0; i < CHANNELS; i++)
+        {
+            scale[i] = max[i] == 0 ? 1 : 1.0f / max[i];
+            channelMean[i] = sum[i] * invLength * scale[i];
+            mean += channelMean[i];
+        }
+        mean *= 1.0f / CHANNELS;
+
+        // Every channel has the same number of samples, so the variance of all samples combines the variances and means of the channels.
+        // n * sum(x^2) - sum(x)^2 is computed on integers, which avoids the cancellation of the float version.
+        float variance = 0;
+        for (size_t i = 0; i < CHANNELS; i++)
+        {
+            uint64_t spread = (uint64_t) LENGTH * sumSquares[i] - (uint64_t) sum[i] * sum[i];
+            float channelVariance = spread * invLength * invLength * scale[i] * scale[i];
+
+            float difference = channelMean[i] - mean;
+            variance += channelVariance + difference * difference;
+        }
+        variance *= 1.0f / CHANNELS;
+
+        // A capture without any change has no variance, and Rsqrt only approximates normal numbers.
+        // The bound is the variance of a single step of a 10-bit reading, so such a capture comes out as zeros.
+        const float minVariance = 1e-6f;
+        if (variance < minVariance)
+            variance = minVariance;
+
+        float invStd = FastMath::Rsqrt(variance);
+
+        for (size_t i = 0; i < CHANNELS; i++)
+            gain[i] = scale[i] * invStd;
+        offset = mean * invStd;
+    }
+};
+
+/**
+ * @brief Filters every channel with a cascade of N biquads, starting from a zero state.
+ */
+template <int N, size_t CHANNELS>
+class BiquadStage
+{
+
+public:
+    void SetSection(int section, const BiquadCoefficients& c) { filter.SetSection(section, c); }
+
+    template <typename Layout>
+    void Apply(typename Layout::Signal& signal)
+    {
+        static_assert(Layout::CHANNELS == CHANNELS, "The filter has a state per channel");
+
+        filter.Reset();
+        if (Layout::INTERLEAVED)
+            filter.FilterInterleaved(&signal[0][0], Layout::LENGTH);
+        else
+        {
+            for (size_t i = 0; i < CHANNELS; i++)
+                filter.Filter(i, Layout::Channel(signal, i), Layout::LENGTH);
+        }
+    }
+
+private:
+    Biquad<float, N, CHANNELS> filter;
+};
+
+/**
+ * @brief The low pass filter the model is trained on. It is a single all-pole section, whose first two samples
+ *      are passed through, after which the state continues from them as if the filter had produced them
+ *      (see butterworth_filter in Model/data_processing.py and Preprocessor::setLowPassFilter).
+ */
+template <size_t CHANNELS>
+class ModelLowPass
+{
+
+public:
+    void SetSection(const BiquadCoefficients& c)
+    {
+        section = c;
+        filter.SetSection(0, c);
+    }
+
+    template <typename Layout>
+    void Apply(typename Layout::Signal& signal)
+    {
+        static_assert(Layout::CHANNELS == CHANNELS, "The filter has a state per channel");
+
+        for (size_t i = 0; i < CHANNELS; i++)
+            Prime(i, Layout::At(signal, i, 0), Layout::At(signal, i, 1));
+
+        if (Layout::INTERLEAVED)
+            filter.FilterInterleaved(&Layout::At(signal, 0, 2), Layout::LENGTH - 2);
+        else
+        {
+            for (size_t i = 0; i < CHANNELS; i++)
+                filter.Filter(i, &Layout::At(signal, i, 2), Layout::LENGTH - 2);
+        }
+    }
+
+    /**
+     * @brief Filters the sample at index of a signal that comes in one sample at a time.
+     *
+     * @param channel - Index of the channel, in range [0, CHANNELS).
+     * @param index - Position of the sample in the signal, 0 starts a new signal.
+     * @param x - Input sample.
+     * @return The filtered sample.
+     */
+    float Process(int channel, uint16_t index, float x)
+    {
+        if (index == 0)
+            first[channel] = x;
+        else if (index == 1)
+            Prime(channel, first[channel], x);
+        else
+            return filter.Process(channel, x);
+
+        return x;
+    }
+
+private:
+    void Prime(int channel, float y0, float y1)
+    {
+        filter.SetState(channel, 0, section.a[0] * y1 + section.a[1] * y0, section.a[1] * y1);
+    }
+
+    BiquadCoefficients section = {};
+    Biquad<float, 1, CHANNELS> filter;
+    float first[CHANNELS];
+};
+
+#endif // STAGES_H
\ No newline at end of file
@@ -2,89 +2,174 @@
 
 #include <Arduino.h>
 
-void Preprocessor::runPipeline(uint16_t rawData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH])
+template <template <size_t, size_t> class Layout>
+BasicPreprocessor<Layout>::BasicPreprocessor()
 {
-    // Converting the unsigned integer array to floats so that the pipeline can work with them
-    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
-        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
-            output[i][j] = (float) rawData[i][j];
-    
-    normaliseData();
-    removeMeanDivideStd();
+    setLowPassFilter(1000.0f / READ_PERIOD, LOW_PASS_CUTOFF);
+}
+
+// Technical info from: https://www.youtube.com/watch?v=HJ-C4Incgpw
+// Coefficients are designed on the device, see pipeline/Butterworth.h
+template <template <size_t, size_t> class Layout>
+bool BasicPreprocessor<Layout>::setLowPassFilter(float sampleRate, float cutoff)
+{
+    if (cutoff <= 0 || cutoff >= sampleRate / 2)
+        return false;
+
+    #ifdef DEBUG_PRINTS
+    unsigned long start = micros();
+    #endif
 
-    applyLowPassFilter();
+    BiquadCoefficients design = Butterworth::LowPass(sampleRate, cutoff);
+
+    // The model is trained on a recurrence that filters in place, so the x[n-1] and x[n-2] terms
+    // read outputs that were already filtered (see butterworth_filter in Model/data_processing.py).
+    // That is the all-pole section below, which keeps the input of the model the same.
+    BiquadCoefficients lowPass;
+    lowPass.b[0] = design.b[0];
+    lowPass.b[1] = 0;
+    lowPass.b[2] = 0;
+    lowPass.a[0] = design.a[0] + design.b[1];
+    lowPass.a[1] = design.a[1] + design.b[2];
+
+    referencePipeline.GetStage<3>().SetSection(lowPass);
+    fastPipeline.GetStage<1>().SetSection(lowPass);
+    streamFilter.SetSection(lowPass);
+
+    // The response to a constant signal, for the rescale at the end of the streaming pre-processing
+    ModelLowPass<1> unitFilter;
+    unitFilter.SetSection(lowPass);
+    for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+        unitResponse[0][j] = 1;
+    unitFilter.Apply<PlanarLayout<1, NUM_DATAPOINTS>>(unitResponse);
+
+    // A capture that is being streamed was partly filtered with the old filter
+    streamValid = false;
+
+    #ifdef DEBUG_PRINTS
+    unsigned long duration = micros() - start;
+    Serial.print("Low pass filter designed in ");
+    Serial.print(duration);
+    Serial.print(" microseconds, a = {");
+    Serial.print(design.a[0], 8);
+    Serial.print(", ");
+    Serial.print(design.a[1], 8);
+    Serial.print("}, b = {");
+    Serial.print(design.b[0], 8);
+    Serial.print(", ");
+    Serial.print(design.b[1], 8);
+    Serial.print(", ");
+    Serial.print(design.b[2], 8);
+    Serial.println("}");
+    #endif // DEBUG_PRINTS
+
+    return true;
 }
 
-void Preprocessor::normaliseData()
+template <template <size_t, size_t> class Layout>
+void BasicPreprocessor<Layout>::runPipeline(const Capture& rawData)
 {
-    // Normalize dividing by the max
-    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
-        maxNormaliser.Normalise(output[i], NUM_DATAPOINTS);
+    #ifdef FAST_MATH_PREPROCESSING
+    runFastPipeline(rawData);
+    #else
+    runReferencePipeline(rawData);
+    #endif // FAST_MATH_PREPROCESSING
 }
 
-void Preprocessor::removeMeanDivideStd()
+template <template <size_t, size_t> class Layout>
+const typename BasicPreprocessor<Layout>::OutputLayout::Raw& BasicPreprocessor<Layout>::prepareCapture(const Capture& rawData)
 {
-    float mean = 0;
-    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++) 
+    // Both are the same type when the lengths are equal
+    if (GESTURE_BUFFER_LENGTH == NUM_DATAPOINTS)
+        return reinterpret_cast<const typename OutputLayout::Raw&>(rawData);
+
+    // Captures of another length, or taken at another sample rate, are first resampled onto the time grid of the model.
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
     {
+        uint16_t captured[GESTURE_BUFFER_LENGTH];
+        uint16_t stretched[NUM_DATAPOINTS];
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+            captured[j] = InputLayout::At(rawData, i, j);
+
+        resampler.Resample(captured, GESTURE_BUFFER_LENGTH, stretched, NUM_DATAPOINTS);
+
         for (size_t j = 0; j < NUM_DATAPOINTS; j++)
-        {
-            mean += output[i][j];
-        }
+            OutputLayout::At(resampled, i, j) = stretched[j];
     }
-    mean /= (NUM_LIGHT_SENSORS * NUM_DATAPOINTS);
 
-    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++) 
+    return resampled;
+}
+
+template <template <size_t, size_t> class Layout>
+void BasicPreprocessor<Layout>::runReferencePipeline(const Capture& rawData)
+{
+    referencePipeline.Run<OutputLayout>(prepareCapture(rawData), output);
+}
+
+template <template <size_t, size_t> class Layout>
+void BasicPreprocessor<Layout>::runFastPipeline(const Capture& rawData)
+{
+    fastPipeline.Run<OutputLayout>(prepareCapture(rawData), output);
+}
+
+template <template <size_t, size_t> class Layout>
+void BasicPreprocessor<Layout>::feedSample(const uint16_t sample[NUM_LIGHT_SENSORS], uint16_t index)
+{
+    // Captures that are resampled first can only be pre-processed when they are complete
+    if (GESTURE_BUFFER_LENGTH != NUM_DATAPOINTS)
+        return;
+
+    if (index == 0)
     {
-        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+        streamLength = 0;
+        streamValid = true;
+        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
         {
-            output[i][j] -= mean;
+            streamMax[i] = 0;
+            streamSum[i] = 0;
+            streamSumSquares[i] = 0;
         }
     }
-
-    float std = 0;
-    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++) 
+    else if (index != streamLength)
     {
-        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
-        {
-            std += output[i][j] * output[i][j];
-        }
+        // A sample was missed, runPipeline is used for this capture
+        streamValid = false;
     }
-    std /= (NUM_LIGHT_SENSORS * NUM_DATAPOINTS);
-    std = sqrt(std);
 
-    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++) 
+    if (!streamValid || streamLength >= NUM_DATAPOINTS)
+        return;
+
+    streamLength++;
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
     {
-        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
-        {
-            output[i][j] /= std;
-        }
+        uint16_t x = sample[i];
+
+        if (x > streamMax[i])
+            streamMax[i] = x;
+        streamSum[i] += x;
+        streamSumSquares[i] += (uint32_t) x * x;
+
+        OutputLayout::At(streamed, i, index) = streamFilter.Process(i, index, x);
     }
 }
 
-// Technical info from: https://www.youtube.com/watch?v=HJ-C4Incgpw
-// Coefficients calculated using https://github.com/curiores/ArduinoTutorials/blob/main/BasicFilters/Design/LowPass/ButterworthFilter.ipynb
-void Preprocessor::applyLowPassFilter()
-{   
-    // Coefficients for a 2nd order Butterworth filter
-    // Calculated using sample rate of 100 Hz and cutoff frequency of 25 Hz
-    static const float a[] = {0.28094574, -0.18556054};
-    static const float b[] = {0.2261537, 0.4523074, 0.2261537}; 
-
-    // Formula for 2nd order Butterworth filter, where a and b are the coefficients and x and y are the input and output respectively
-    // y[n] = a[0] * y[n-1] + a[1] * y[n-2] + b[0] * x[n] + b[1] * x[n-1] + b[2] * x[n-2]
-
-    // For each photo diode we want to do a separate run of the filter
-    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
-    {
-        // The first two values of the output are the same as the input
-        // output[i][0] = output[i][0];
-        // output[i][1] = output[i][1];
+template <template <size_t, size_t> class Layout>
+void BasicPreprocessor<Layout>::finalizeStream()
+{
+    float gain[NUM_LIGHT_SENSORS];
+    float offset;
+    Standardise::Compute<NUM_LIGHT_SENSORS, NUM_DATAPOINTS>(streamMax, streamSum, streamSumSquares, gain, offset);
 
-        // The rest of the values are calculated using the formula above
-        for (size_t j = 2; j < NUM_DATAPOINTS; j++)
-        {
-            output[i][j] = a[0] * output[i][j-1] + a[1] * output[i][j-2] + b[0] * output[i][j] + b[1] * output[i][j-1] + b[2] * output[i][j-2];
-        }
+    for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+    {
+        const float shift = unitResponse[0][j] * offset;
+        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+            OutputLayout::At(output, i, j) = OutputLayout::At(streamed, i, j) * gain[i] - shift;
     }
-}
\ No newline at end of file
+
+    streamValid = false;
+}
+
+template class BasicPreprocessor<PlanarLayout>;
+template class BasicPreprocessor<InterleavedLayout>;
\ No newline at end of file
@@ -7,26 +7,95 @@
 
 #include <stdint.h>
 
-#include "pre-processing/pipeline/MaxNormaliser.h"
+#include "util/capture_buffer.hpp"
 
-class Preprocessor {
+#include "pre-processing/pipeline/Resampler.h"
+#include "pre-processing/pipeline/Butterworth.h"
+#include "pre-processing/pipeline/Layout.h"
+#include "pre-processing/pipeline/Pipeline.h"
+#include "pre-processing/pipeline/Stages.h"
+
+// The integer sums of squares of a capture must fit in 32 bits
+static_assert((uint64_t) NUM_DATAPOINTS * ADC_MAX_READING * ADC_MAX_READING <= UINT32_MAX, "Sum of squares of a capture overflows");
+
+// The pre-processing step by step like preprocess_data in Model/data_processing.py, with a divide per sample
+typedef Pipeline<ToFloat, MaxNormalise, ZScore, ModelLowPass<NUM_LIGHT_SENSORS>> ReferencePipeline;
+
+// The same pre-processing without divides per sample, see Standardise
+typedef Pipeline<Standardise, ModelLowPass<NUM_LIGHT_SENSORS>> FastPipeline;
+
+// Pre-processes captures that are stored in Layout (PlanarLayout or InterleavedLayout, see pipeline/Layout.h),
+// the output is in the same layout. Both layouts are compiled in preprocessor.cpp, the firmware uses Preprocessor.
+template <template <size_t, size_t> class Layout>
+class BasicPreprocessor {
 public:
-    void runPipeline(uint16_t rawData[NUM_LIGHT_SENSORS][GESTURE_BUFFER_LENGTH]);
+    typedef Layout<NUM_LIGHT_SENSORS, GESTURE_BUFFER_LENGTH> InputLayout;
+    typedef Layout<NUM_LIGHT_SENSORS, NUM_DATAPOINTS> OutputLayout;
+    typedef typename InputLayout::Raw Capture;
+    typedef typename OutputLayout::Signal Output;
+
+    BasicPreprocessor();
+
+    // Runs runFastPipeline with FAST_MATH_PREPROCESSING, otherwise runReferencePipeline
+    void runPipeline(const Capture& rawData);
+
+    void runReferencePipeline(const Capture& rawData);
+    void runFastPipeline(const Capture& rawData);
 
-    auto getPipelineOutput() {
+    Output& getPipelineOutput() {
         return output;
     }
+
+    // Designs the low pass filter for the given sample rate and cutoff frequency in Hz.
+    // Returns false, and keeps the current filter, when the cutoff is not below the Nyquist frequency.
+    bool setLowPassFilter(float sampleRate, float cutoff);
+
+    // Streaming pre-processing, fed with every sample of a capture while it is acquired.
+    // Index 0 starts a new capture, the samples must follow each other without gaps.
+    void feedSample(const uint16_t sample[NUM_LIGHT_SENSORS], uint16_t index);
+
+    // Whether all NUM_DATAPOINTS samples of the capture were fed and not finalised yet
+    bool isStreamComplete() { return streamValid && streamLength == NUM_DATAPOINTS; }
+
+    // Writes the pre-processed capture to the pipeline output, the same result as runPipeline on the capture.
+    // Only the rescale of the filtered samples is left to do, in one pass.
+    void finalizeStream();
     
 private:
-    float output[NUM_LIGHT_SENSORS][NUM_DATAPOINTS];
+    Output output;
 
-    void normaliseData();
-    void removeMeanDivideStd();
+    // Resamples the capture when its length differs from NUM_DATAPOINTS, returns the samples of the model time grid
+    const typename OutputLayout::Raw& prepareCapture(const Capture& rawData);
 
-    void applyLowPassFilter();
+    ReferencePipeline referencePipeline;
+    FastPipeline fastPipeline;
 
-    MaxNormaliser maxNormaliser;
+    // Output of the low pass filter for a signal that is 1 everywhere.
+    // The filter is linear, so filtering (x / max - mean) / std is the same as x filtered, divided by max * std,
+    // minus mean / std times this response. That allows filtering the raw samples while they come in.
+    float unitResponse[1][NUM_DATAPOINTS];
+
+    // State of the streaming pre-processing: the raw samples filtered so far, and per channel their maximum,
+    // sum and sum of squares. The sums are exact for integer samples and, unlike Welford, need no divide per sample.
+    ModelLowPass<NUM_LIGHT_SENSORS> streamFilter;
+    Output streamed;
+    uint16_t streamMax[NUM_LIGHT_SENSORS];
+    uint32_t streamSum[NUM_LIGHT_SENSORS];
+    uint32_t streamSumSquares[NUM_LIGHT_SENSORS];
+    uint16_t streamLength = 0;
+    bool streamValid = false;
+
+    // Maps captures of GESTURE_BUFFER_LENGTH samples onto the NUM_DATAPOINTS of the model
+    #ifdef POLYPHASE_RESAMPLING
+    Resampler resampler{Resampler::POLYPHASE};
+    #else
+    Resampler resampler{Resampler::LINEAR};
+    #endif // POLYPHASE_RESAMPLING
+    typename OutputLayout::Raw resampled;
     
 };
 
+// The pre-processing of the firmware, in the layout of the captures (see INTERLEAVED_CAPTURES)
+typedef BasicPreprocessor<SampleLayout> Preprocessor;
+
 #endif // PREPROCESSOR_HPP
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "calibration_store.hpp"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef ARDUINO_ARCH_MBED
+#include <FlashIAP.h>
+#else
+#include <stdio.h>
+#endif // ARDUINO_ARCH_MBED
+
+static uint32_t calculateChecksum(const CalibrationRecord* record)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(record);
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < offsetof(CalibrationRecord, checksum); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// A record with a valid checksum can still hold values this build can't use, for example when a constant changed
+static bool isValid(const CalibrationRecord* record)
+{
+    if (record->resistorIndex < 0 || record->resistorIndex >= POWER_SET_SIZE)
+        return false;
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        if (record->thresholds[i] > ADC_MAX_READING)
+            return false;
+    }
+
+    for (size_t i = 0; i < POWER_SET_SIZE; i++)
+    {
+        if (!isfinite(record->gains[i]) || record->gains[i] < 0)
+            return false;
+    }
+
+    // A hop size of 0 means it was not measured
+    if (record->hopSize != 0 && (record->hopSize < CONTINUOUS_MIN_HOP || record->hopSize > GESTURE_BUFFER_LENGTH))
+        return false;
+
+    return record->reserved == 0;
+}
+
+#ifdef ARDUINO_ARCH_MBED
+
+// The record is kept in the last sector of the flash. The program is kept out of it by board_upload.maximum_size in
+// platformio.ini, so the build fails instead of the program being overwritten when it grows into the sector.
+static uint32_t recordSectorSize(mbed::FlashIAP& flash)
+{
+    return flash.get_sector_size(flash.get_flash_start() + flash.get_flash_size() - 1);
+}
+
+static uint32_t recordAddress(mbed::FlashIAP& flash)
+{
+    return flash.get_flash_start() + flash.get_flash_size() - recordSectorSize(flash);
+}
+
+static bool readRecord(CalibrationRecord* record)
+{
+    mbed::FlashIAP flash;
+    if (flash.init() != 0)
+        return false;
+
+    int result = flash.read(record, recordAddress(flash), sizeof(CalibrationRecord));
+
+    flash.deinit();
+    return result == 0;
+}
+
+static bool writeRecord(const CalibrationRecord* record)
+{
+    mbed::FlashIAP flash;
+    if (flash.init() != 0)
+        return false;
+
+    int result = -1;
+    if (sizeof(CalibrationRecord) % flash.get_page_size() == 0 && flash.erase(recordAddress(flash), recordSectorSize(flash)) == 0)
+        result = flash.program(record, recordAddress(flash), sizeof(CalibrationRecord));
+
+    flash.deinit();
+    return result == 0;
+}
+
+#else
+
+static bool readRecord(CalibrationRecord* record)
+{
+    FILE* file = fopen(CALIBRATION_RECORD_FILE, "rb");
+    if (file == nullptr)
+        return false;
+
+    size_t read = fread(record, sizeof(CalibrationRecord), 1, file);
+    fclose(file);
+    return read == 1;
+}
+
+static bool writeRecord(const CalibrationRecord* record)
+{
+    FILE* file = fopen(CALIBRATION_RECORD_FILE, "wb");
+    if (file == nullptr)
+        return false;
+
+    size_t written = fwrite(record, sizeof(CalibrationRecord), 1, file);
+    fclose(file);
+    return written == 1;
+}
+
+#endif // ARDUINO_ARCH_MBED
+
+bool loadCalibrationRecord(CalibrationRecord* record)
+{
+    if (!readRecord(record))
+        return false;
+
+    // Erased flash reads as all ones, which is caught by the magic number
+    return record->magic == CALIBRATION_RECORD_MAGIC &&
+           record->version == CALIBRATION_RECORD_VERSION &&
+           record->size == sizeof(CalibrationRecord) &&
+           record->checksum == calculateChecksum(record) &&
+           isValid(record);
+}
+
+bool storeCalibrationRecord(CalibrationRecord* record)
+{
+    record->magic = CALIBRATION_RECORD_MAGIC;
+    record->version = CALIBRATION_RECORD_VERSION;
+    record->size = sizeof(CalibrationRecord);
+    record->reserved = 0;
+    record->checksum = calculateChecksum(record);
+
+    // Don't wear the flash when nothing changed
+    CalibrationRecord stored;
+    if (readRecord(&stored) && memcmp(&stored, record, sizeof(CalibrationRecord)) == 0)
+        return true;
+
+    return writeRecord(record);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef CALIBRATION_STORE_HPP
+#define CALIBRATION_STORE_HPP
+
+#include <stdint.h>
+
+#include "global_constants.hpp"
+
+#include "light_sensors/light_intensity_regulator.hpp"
+
+// Identifies the layout of the CalibrationRecord, increase it whenever the record changes.
+#define CALIBRATION_RECORD_MAGIC 0x47524352 // "GRCR"
+#define CALIBRATION_RECORD_VERSION 1
+
+// File that holds the record when not running on the microcontroller.
+#define CALIBRATION_RECORD_FILE "calibration_record.bin"
+
+/**
+ * @brief The state that is learned at runtime and needed to start detecting gestures right after power-on:
+ *        the chosen resistor and gain model of the light sensors, the edge detection thresholds and the model selection.
+ *        Kept in the last sector of the flash on the microcontroller.
+ */
+struct CalibrationRecord
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+
+    int16_t resistorIndex;
+    uint16_t thresholds[NUM_LIGHT_SENSORS];
+    float gains[POWER_SET_SIZE];
+
+    // Model variant the record was made with and the continuous inference hop size that was measured for it
+    uint8_t modelVariant;
+    uint8_t reserved;
+    uint16_t hopSize;
+
+    // FNV-1a hash of all fields above
+    uint32_t checksum;
+};
+
+static_assert(sizeof(CalibrationRecord) % 4 == 0, "Flash is programmed in whole words");
+
+// Reads the stored record. Returns false when there is none, it was written by another version or a field is out of range.
+bool loadCalibrationRecord(CalibrationRecord* record);
+
+// Stores the record, the header and checksum are filled in. Returns false when it could not be written.
+// Erasing the flash takes tens of milliseconds, so this should only be called between gestures.
+bool storeCalibrationRecord(CalibrationRecord* record);
+
+#endif // CALIBRATION_STORE_HPP
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef CAPTURE_BUFFER_HPP
+#define CAPTURE_BUFFER_HPP
+
+#include <stdint.h>
+
+#include "global_constants.hpp"
+
+#include "pre-processing/pipeline/Layout.h"
+
+// Order of the samples of the light sensors in the captures, the pre-processing and its output, see INTERLEAVED_CAPTURES
+#ifdef INTERLEAVED_CAPTURES
+template <size_t CHANNELS, size_t LENGTH>
+using SampleLayout = InterleavedLayout<CHANNELS, LENGTH>;
+#else
+template <size_t CHANNELS, size_t LENGTH>
+using SampleLayout = PlanarLayout<CHANNELS, LENGTH>;
+#endif // INTERLEAVED_CAPTURES
+
+// A capture of GESTURE_BUFFER_LENGTH samples of every light sensor, read with CaptureLayout::At(capture, sensor, n)
+typedef SampleLayout<NUM_LIGHT_SENSORS, GESTURE_BUFFER_LENGTH> CaptureLayout;
+typedef CaptureLayout::Raw CaptureBuffer;
+
+#endif // CAPTURE_BUFFER_HPP
\ No newline at end of file
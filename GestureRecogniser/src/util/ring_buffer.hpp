@@ -0,0 +1,60 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief A fixed size ring buffer that keeps the last N pushed values. Pushing never moves data around,
+ *        which makes it cheap to keep a continuously running history of samples.
+ */
+template <typename T, size_t N>
+class RingBuffer
+{
+public:
+    void push(T value)
+    {
+        data[head] = value;
+        head = (head + 1) % N;
+
+        if (count < N)
+            count++;
+    }
+
+    // Element i counted from the oldest value in the buffer
+    T operator[](size_t i) const { return data[(head + N - count + i) % N]; }
+    T& operator[](size_t i) { return data[(head + N - count + i) % N]; }
+
+    // Most recently pushed value
+    T last() const { return data[(head + N - 1) % N]; }
+
+    size_t size() const { return count; }
+    bool full() const { return count == N; }
+    void clear() { head = 0; count = 0; }
+
+    // Copies the last length values (oldest first) to a contiguous destination array
+    void copyTo(T* destination, size_t length = N) const
+    {
+        size_t start = (head + N - length) % N;
+        size_t firstPart = N - start < length ? N - start : length;
+
+        memcpy(destination, &data[start], firstPart * sizeof(T));
+        memcpy(destination + firstPart, data, (length - firstPart) * sizeof(T));
+    }
+
+    // Same as above, into every stride-th element of destination, for buffers that interleave several signals
+    void copyTo(T* destination, size_t length, size_t stride) const
+    {
+        size_t start = (head + N - length) % N;
+        for (size_t i = 0; i < length; i++)
+            destination[i * stride] = data[(start + i) % N];
+    }
+
+private:
+    T data[N];
+    size_t head = 0;
+    size_t count = 0;
+};
+
+#endif // RING_BUFFER_HPP
\ No newline at end of file
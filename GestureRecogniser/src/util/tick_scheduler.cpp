@@ -0,0 +1,61 @@
+#include "tick_scheduler.hpp"
+
+static void sleepFor(unsigned long ms)
+{
+#if defined(ARDUINO_ARCH_MBED)
+    // delay() suspends the thread, the idle thread of mbed OS then puts the CPU to sleep (WFI) until the wake-up timer fires
+    delay(ms);
+#elif defined(__arm__)
+    // The SysTick interrupt behind millis() wakes the CPU every millisecond
+    unsigned long start = millis();
+    while (millis() - start < ms)
+        __WFI();
+#else
+    // On the host there is nothing to sleep for, the clock is not advanced
+    (void)ms;
+#endif
+}
+
+void TickScheduler::resync()
+{
+    nextTickMs = millis() + periodMs;
+    wakeUs = micros();
+}
+
+void TickScheduler::sleepUntilNextTick()
+{
+    unsigned long sleepUs = micros();
+    unsigned long active = sleepUs - wakeUs;
+
+    long remainingMs = (long)(nextTickMs - millis());
+    if (remainingMs > 0)
+        sleepFor(remainingMs);
+
+    wakeUs = micros();
+
+    ticks++;
+    activeUs += active;
+    idleUs += wakeUs - sleepUs;
+    if (active > maxActiveUs)
+        maxActiveUs = active;
+
+    // A tick that took longer than the period (a gesture capture) skips the ticks that were missed
+    while ((long)(millis() - nextTickMs) >= 0)
+        nextTickMs += periodMs;
+}
+
+void TickScheduler::report()
+{
+    Serial.print("Active per tick: ");
+    Serial.print(getAverageActiveUs());
+    Serial.print(" us (max ");
+    Serial.print(getMaxActiveUs());
+    Serial.print(" us), idle ");
+    Serial.print(getIdleFraction() * 100);
+    Serial.println("%");
+
+    ticks = 0;
+    activeUs = 0;
+    idleUs = 0;
+    maxActiveUs = 0;
+}
\ No newline at end of file
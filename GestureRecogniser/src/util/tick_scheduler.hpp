@@ -0,0 +1,46 @@
+#ifndef TICK_SCHEDULER_HPP
+#define TICK_SCHEDULER_HPP
+
+#include <Arduino.h>
+
+#include <stdint.h>
+
+/**
+ * @brief Sleeps between the ticks of the sampling timer instead of spinning on SimpleTimer::run(),
+ *        and measures how much of every tick is spent active and how much asleep.
+ *        Ticks are aligned to the sampling timer with resync(), call it whenever that timer is restarted.
+ */
+class TickScheduler
+{
+public:
+    TickScheduler(unsigned long periodMs) : periodMs(periodMs) {}
+
+    // Starts a new tick grid at the current time
+    void resync();
+
+    // Changes the period of the ticks, resync() when the sampling timer is restarted with the new period
+    void setPeriod(unsigned long periodMs) { this->periodMs = periodMs; }
+
+    // Sleeps until the next tick, call it at the end of loop()
+    void sleepUntilNextTick();
+
+    // Statistics since the last report
+    unsigned long getAverageActiveUs() { return ticks == 0 ? 0 : activeUs / ticks; }
+    unsigned long getMaxActiveUs() { return maxActiveUs; }
+    float getIdleFraction() { return activeUs + idleUs == 0 ? 0 : (float)idleUs / (activeUs + idleUs); }
+
+    // Prints the statistics over serial and starts new ones
+    void report();
+
+private:
+    unsigned long periodMs;
+    unsigned long nextTickMs = 0;
+    unsigned long wakeUs = 0;
+
+    uint32_t ticks = 0;
+    uint64_t activeUs = 0;
+    uint64_t idleUs = 0;
+    unsigned long maxActiveUs = 0;
+};
+
+#endif // TICK_SCHEDULER_HPP
\ No newline at end of file
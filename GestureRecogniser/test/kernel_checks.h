@@ -0,0 +1,143 @@
+/**
+ * @file kernel_checks.h
+ * @brief The tests of test_kernels and test_kernels_dsp: Kernels, with whichever backend is compiled in, against
+ *      ScalarKernels. The integer results must be exact, the float results within 1 ulp (see Kernels).
+ *
+ */
+#ifndef KERNEL_CHECKS_H
+#define KERNEL_CHECKS_H
+
+#include <unity.h>
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "pre-processing/pipeline/Kernels.h"
+
+static const int KERNEL_CHANNELS = 3;
+
+// Long enough for every vector width, odd so the tails after the vector loops are covered too
+static const int KERNEL_LENGTHS[] = {0, 1, 2, 3, 7, 8, 9, 15, 17, 100, 101};
+static const int KERNEL_MAX_LENGTH = 101;
+
+// A float result of Kernels against the one of ScalarKernels
+#define ASSERT_WITHIN_ULP(expected, actual) TEST_ASSERT_FLOAT_WITHIN(fabsf(expected) * FLT_EPSILON, expected, actual)
+
+// Random samples below maximum
+static void randomSamples(uint16_t *samples, int count, uint32_t maximum)
+{
+    for (int i = 0; i < count; i++)
+        samples[i] = (uint16_t) (rand() % (maximum + 1));
+}
+
+void setUp() { srand(13); }
+void tearDown() {}
+
+void test_statistics_match()
+{
+    // 10 bit readings, and full scale of the signed SMLAD halves where the sums of squares wrap around alike
+    const uint32_t maxima[] = {1023, 32767};
+    for (uint32_t maximum : maxima)
+    {
+        for (int length : KERNEL_LENGTHS)
+        {
+            uint16_t samples[KERNEL_MAX_LENGTH];
+            randomSamples(samples, length, maximum);
+
+            uint16_t scalarMax, max;
+            uint32_t scalarSum, sum, scalarSquares, squares;
+            ScalarKernels::Statistics(samples, length, scalarMax, scalarSum, scalarSquares);
+            Kernels::Statistics(samples, length, max, sum, squares);
+
+            TEST_ASSERT_EQUAL_UINT16(scalarMax, max);
+            TEST_ASSERT_EQUAL_UINT32(scalarSum, sum);
+            TEST_ASSERT_EQUAL_UINT32(scalarSquares, squares);
+        }
+    }
+}
+
+void test_statistics_find_the_maximum_in_either_half()
+{
+    // The maximum at every position, so once in the low and once in the high half of a 32 bit word
+    for (int position = 0; position < 9; position++)
+    {
+        uint16_t samples[9] = {};
+        samples[position] = 1023;
+
+        uint16_t max;
+        uint32_t sum, squares;
+        Kernels::Statistics(samples, 9, max, sum, squares);
+        TEST_ASSERT_EQUAL_UINT16(1023, max);
+    }
+}
+
+void test_interleaved_statistics_match()
+{
+    for (int length : KERNEL_LENGTHS)
+    {
+        uint16_t samples[KERNEL_MAX_LENGTH * KERNEL_CHANNELS];
+        randomSamples(samples, length * KERNEL_CHANNELS, 1023);
+
+        uint16_t scalarMax[KERNEL_CHANNELS], max[KERNEL_CHANNELS];
+        uint32_t scalarSum[KERNEL_CHANNELS], sum[KERNEL_CHANNELS];
+        uint32_t scalarSquares[KERNEL_CHANNELS], squares[KERNEL_CHANNELS];
+        ScalarKernels::StatisticsInterleaved(samples, length, scalarMax, scalarSum, scalarSquares);
+        Kernels::StatisticsInterleaved(samples, length, max, sum, squares);
+
+        TEST_ASSERT_EQUAL_UINT16_ARRAY(scalarMax, max, KERNEL_CHANNELS);
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(scalarSum, sum, KERNEL_CHANNELS);
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(scalarSquares, squares, KERNEL_CHANNELS);
+    }
+}
+
+void test_float_kernels_match()
+{
+    for (int length : KERNEL_LENGTHS)
+    {
+        uint16_t samples[KERNEL_MAX_LENGTH];
+        randomSamples(samples, length, 1023);
+
+        float scalar[KERNEL_MAX_LENGTH], vector[KERNEL_MAX_LENGTH];
+        ScalarKernels::ToFloat(samples, scalar, length);
+        Kernels::ToFloat(samples, vector, length);
+        for (int i = 0; i < length; i++)
+            ASSERT_WITHIN_ULP(scalar[i], vector[i]);
+
+        ASSERT_WITHIN_ULP(ScalarKernels::Max(scalar, length), Kernels::Max(vector, length));
+
+        ScalarKernels::Affine(samples, scalar, length, 0.0123f, -4.5f);
+        Kernels::Affine(samples, vector, length, 0.0123f, -4.5f);
+        for (int i = 0; i < length; i++)
+            ASSERT_WITHIN_ULP(scalar[i], vector[i]);
+    }
+}
+
+void test_interleaved_affine_matches()
+{
+    const float gain[KERNEL_CHANNELS] = {0.0123f, 0.0045f, 0.0067f};
+    for (int length : KERNEL_LENGTHS)
+    {
+        uint16_t samples[KERNEL_MAX_LENGTH * KERNEL_CHANNELS];
+        randomSamples(samples, length * KERNEL_CHANNELS, 1023);
+
+        float scalar[KERNEL_MAX_LENGTH * KERNEL_CHANNELS], vector[KERNEL_MAX_LENGTH * KERNEL_CHANNELS];
+        ScalarKernels::AffineInterleaved(samples, scalar, length, gain, -4.5f);
+        Kernels::AffineInterleaved(samples, vector, length, gain, -4.5f);
+        for (int i = 0; i < length * KERNEL_CHANNELS; i++)
+            ASSERT_WITHIN_ULP(scalar[i], vector[i]);
+    }
+}
+
+static int runKernelTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_statistics_match);
+    RUN_TEST(test_statistics_find_the_maximum_in_either_half);
+    RUN_TEST(test_interleaved_statistics_match);
+    RUN_TEST(test_float_kernels_match);
+    RUN_TEST(test_interleaved_affine_matches);
+    return UNITY_END();
+}
+
+#endif // KERNEL_CHECKS_H
\ No newline at end of file
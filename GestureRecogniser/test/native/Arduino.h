@@ -0,0 +1,26 @@
+/**
+ * @file Arduino.h
+ * @brief The part of the Arduino core that the sources built for the native tests use: the integer types and the pin
+ *      names of the Nano 33 BLE. Nothing here touches hardware, code that reads or writes pins is not built on the host.
+ *
+ */
+#ifndef ARDUINO_NATIVE_STUB_H
+#define ARDUINO_NATIVE_STUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Pin numbers of the Nano 33 BLE variant
+#define D9 (9u)
+#define D10 (10u)
+#define D11 (11u)
+#define D12 (12u)
+
+#define A0 (14u)
+#define A1 (15u)
+#define A2 (16u)
+
+#endif // ARDUINO_NATIVE_STUB_H
\ No newline at end of file
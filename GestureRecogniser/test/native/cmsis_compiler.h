@@ -0,0 +1,36 @@
+/**
+ * @file cmsis_compiler.h
+ * @brief The dual 16 bit intrinsics of the Cortex-M4 DSP extension that Kernels.h uses, written out in plain C++ so the
+ *      DSP kernels can be tested on the host, see test_kernels_dsp. Only included when __ARM_FEATURE_DSP is defined.
+ *
+ */
+#ifndef CMSIS_COMPILER_NATIVE_STUB_H
+#define CMSIS_COMPILER_NATIVE_STUB_H
+
+#include <stdint.h>
+
+// Multiplies the signed halves of x and y pairwise and adds both products to the accumulator
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t accumulator)
+{
+    int32_t low = (int32_t) (int16_t) (x & 0xFFFF) * (int16_t) (y & 0xFFFF);
+    int32_t high = (int32_t) (int16_t) (x >> 16) * (int16_t) (y >> 16);
+    return accumulator + (uint32_t) low + (uint32_t) high;
+}
+
+// Subtracts the unsigned halves of y from those of x, saturating at 0
+static inline uint32_t __UQSUB16(uint32_t x, uint32_t y)
+{
+    uint32_t low = (x & 0xFFFF) > (y & 0xFFFF) ? (x & 0xFFFF) - (y & 0xFFFF) : 0;
+    uint32_t high = (x >> 16) > (y >> 16) ? (x >> 16) - (y >> 16) : 0;
+    return (high << 16) | low;
+}
+
+// Adds the halves of x and y, each wrapping around at 16 bit
+static inline uint32_t __UADD16(uint32_t x, uint32_t y)
+{
+    uint32_t low = ((x & 0xFFFF) + (y & 0xFFFF)) & 0xFFFF;
+    uint32_t high = ((x >> 16) + (y >> 16)) & 0xFFFF;
+    return (high << 16) | low;
+}
+
+#endif // CMSIS_COMPILER_NATIVE_STUB_H
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pre-processing/pipeline/Biquad.h"
+#include "pre-processing/pipeline/Butterworth.h"
+#include "pre-processing/pipeline/Layout.h"
+#include "pre-processing/pipeline/Stages.h"
+
+static const int LENGTH = 100;
+
+void setUp() { srand(7); }
+void tearDown() {}
+
+// A random signal in [-1, 1)
+static void randomSignal(float* signal, int length)
+{
+    for (int n = 0; n < length; n++)
+        signal[n] = rand() / (RAND_MAX + 1.0f) * 2 - 1;
+}
+
+// The difference equation of BiquadCoefficients in double precision, as the reference for the transposed direct form
+static void directForm(const BiquadCoefficients& c, const float* x, double* y, int length)
+{
+    for (int n = 0; n < length; n++)
+    {
+        double acc = c.b[0] * (double) x[n];
+        if (n >= 1)
+            acc += c.b[1] * (double) x[n - 1] + c.a[0] * y[n - 1];
+        if (n >= 2)
+            acc += c.b[2] * (double) x[n - 2] + c.a[1] * y[n - 2];
+        y[n] = acc;
+    }
+}
+
+void test_section_matches_difference_equation()
+{
+    BiquadCoefficients c = Butterworth::LowPass(100, 25);
+    float signal[LENGTH];
+    double expected[LENGTH];
+    randomSignal(signal, LENGTH);
+    directForm(c, signal, expected, LENGTH);
+
+    Biquad<float, 1> filter;
+    filter.SetSection(0, c);
+    filter.Filter(0, signal, LENGTH);
+
+    for (int n = 0; n < LENGTH; n++)
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected[n], signal[n]);
+}
+
+void test_cascade_runs_sections_in_order()
+{
+    BiquadCoefficients lowPass = Butterworth::LowPass(100, 10);
+    BiquadCoefficients highPass = Butterworth::HighPass(100, 2);
+    float signal[LENGTH];
+    double first[LENGTH];
+    double expected[LENGTH];
+    randomSignal(signal, LENGTH);
+
+    directForm(lowPass, signal, first, LENGTH);
+    float intermediate[LENGTH];
+    for (int n = 0; n < LENGTH; n++)
+        intermediate[n] = (float) first[n];
+    directForm(highPass, intermediate, expected, LENGTH);
+
+    Biquad<float, 2> filter;
+    filter.SetSection(0, lowPass);
+    filter.SetSection(1, highPass);
+    filter.Filter(0, signal, LENGTH);
+
+    for (int n = 0; n < LENGTH; n++)
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected[n], signal[n]);
+}
+
+void test_process_filter_and_interleaved_agree()
+{
+    const int CHANNELS = 3;
+    BiquadCoefficients c = Butterworth::LowPass(100, 20);
+
+    float planar[CHANNELS][LENGTH];
+    float interleaved[LENGTH][CHANNELS];
+    float processed[CHANNELS][LENGTH];
+    for (int i = 0; i < CHANNELS; i++)
+    {
+        randomSignal(planar[i], LENGTH);
+        for (int n = 0; n < LENGTH; n++)
+            interleaved[n][i] = processed[i][n] = planar[i][n];
+    }
+
+    Biquad<float, 2, CHANNELS> block, frames, samples;
+    for (int s = 0; s < 2; s++)
+    {
+        block.SetSection(s, c);
+        frames.SetSection(s, c);
+        samples.SetSection(s, c);
+    }
+
+    for (int i = 0; i < CHANNELS; i++)
+        block.Filter(i, planar[i], LENGTH);
+    frames.FilterInterleaved(&interleaved[0][0], LENGTH);
+    for (int n = 0; n < LENGTH; n++)
+    {
+        for (int i = 0; i < CHANNELS; i++)
+            processed[i][n] = samples.Process(i, processed[i][n]);
+    }
+
+    // The same operations in the same order, so the results are identical
+    for (int i = 0; i < CHANNELS; i++)
+    {
+        for (int n = 0; n < LENGTH; n++)
+        {
+            TEST_ASSERT_EQUAL_MEMORY(&planar[i][n], &interleaved[n][i], sizeof(float));
+            TEST_ASSERT_EQUAL_MEMORY(&planar[i][n], &processed[i][n], sizeof(float));
+        }
+    }
+}
+
+void test_reset_starts_a_new_signal()
+{
+    BiquadCoefficients c = Butterworth::LowPass(100, 25);
+    float first[LENGTH];
+    float second[LENGTH];
+    randomSignal(first, LENGTH);
+    memcpy(second, first, sizeof(first));
+
+    Biquad<float, 1> filter;
+    filter.SetSection(0, c);
+    filter.Filter(0, first, LENGTH);
+    filter.Reset();
+    filter.Filter(0, second, LENGTH);
+
+    TEST_ASSERT_EQUAL_MEMORY(first, second, sizeof(first));
+}
+
+void test_low_pass_has_unit_dc_gain()
+{
+    const float cutoffs[] = {5, 10, 25, 40};
+    for (float cutoff : cutoffs)
+    {
+        Biquad<float, 1> filter;
+        filter.SetSection(0, Butterworth::LowPass(100, cutoff));
+
+        float y = 0;
+        for (int n = 0; n < 1000; n++)
+            y = filter.Process(0, 1.0f);
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.0f, y);
+    }
+}
+
+void test_q15_follows_float_and_saturates()
+{
+    BiquadCoefficients c = Butterworth::LowPass(100, 10);
+    Biquad<float, 2> reference;
+    Biquad<int16_t, 2> fixed;
+    for (int s = 0; s < 2; s++)
+    {
+        reference.SetSection(s, c);
+        fixed.SetSection(s, c);
+    }
+
+    // Half of full scale leaves headroom for the overshoot of the cascade
+    float signal[LENGTH];
+    int16_t samples[LENGTH];
+    randomSignal(signal, LENGTH);
+    for (int n = 0; n < LENGTH; n++)
+    {
+        signal[n] *= 0.5f;
+        samples[n] = (int16_t) lroundf(signal[n] * 32768);
+    }
+
+    reference.Filter(0, signal, LENGTH);
+    fixed.Filter(0, samples, LENGTH);
+
+    // Q2.14 coefficients and a rounded output per section, a few LSB of Q15
+    for (int n = 0; n < LENGTH; n++)
+        TEST_ASSERT_FLOAT_WITHIN(8.0f / 32768, signal[n], samples[n] / 32768.0f);
+
+    // The overshoot of a step from full scale negative to full scale positive clips instead of wrapping around
+    Biquad<int16_t, 1> step;
+    step.SetSection(0, Butterworth::LowPass(100, 40));
+    for (int n = 0; n < 50; n++)
+        step.Process(0, INT16_MIN);
+
+    int16_t peak = INT16_MIN;
+    bool crossed = false;
+    for (int n = 0; n < 50; n++)
+    {
+        int16_t y = step.Process(0, INT16_MAX);
+        if (crossed)
+            TEST_ASSERT_GREATER_THAN(0, y);
+        crossed |= y > 0;
+        if (y > peak)
+            peak = y;
+    }
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX, peak);
+}
+
+void test_model_low_pass_filters_in_place()
+{
+    // butterworth_filter in Model/data_processing.py: the first two samples pass, after that the recurrence
+    // reads outputs where the formula has inputs
+    const BiquadCoefficients design = Butterworth::LowPass(100, 25);
+    BiquadCoefficients section = {{design.a[0] + design.b[1], design.a[1] + design.b[2]}, {design.b[0], 0, 0}};
+
+    float signal[1][LENGTH];
+    double expected[LENGTH];
+    randomSignal(signal[0], LENGTH);
+    for (int n = 0; n < LENGTH; n++)
+        expected[n] = signal[0][n];
+    for (int n = 2; n < LENGTH; n++)
+        expected[n] = design.a[0] * expected[n - 1] + design.a[1] * expected[n - 2] + design.b[0] * expected[n] +
+                      design.b[1] * expected[n - 1] + design.b[2] * expected[n - 2];
+
+    ModelLowPass<1> filter;
+    filter.SetSection(section);
+    filter.Apply<PlanarLayout<1, LENGTH>>(signal);
+
+    for (int n = 0; n < LENGTH; n++)
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected[n], signal[0][n]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_section_matches_difference_equation);
+    RUN_TEST(test_cascade_runs_sections_in_order);
+    RUN_TEST(test_process_filter_and_interleaved_agree);
+    RUN_TEST(test_reset_starts_a_new_signal);
+    RUN_TEST(test_low_pass_has_unit_dc_gain);
+    RUN_TEST(test_q15_follows_float_and_saturates);
+    RUN_TEST(test_model_low_pass_filters_in_place);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <unity.h>
+
+#include "light_sensors/light_intensity_regulator.hpp"
+
+// Readings of the highest resistance of the power set, the OPT101 output is proportional to the feedback resistance
+static float brightness[NUM_LIGHT_SENSORS];
+static int sweeps;
+
+// A simulated OPT101 per light sensor behind the 10-bit ADC
+static int simulatedReading(int sensor, int index)
+{
+    float reading = brightness[sensor] * powerSet.values[index] / powerSet.values[0];
+    return reading > ADC_MAX_READING ? ADC_MAX_READING : (int) reading;
+}
+
+static int simulatedSweep(int index, int readings[NUM_LIGHT_SENSORS])
+{
+    sweeps++;
+    int highest = 0;
+    for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        readings[i] = simulatedReading(i, index);
+        if (readings[i] > highest)
+            highest = readings[i];
+    }
+    return highest;
+}
+
+// The first index at which no sensor reads above maximum, or the last index when there is none
+static int linearSearch(int maximum)
+{
+    int readings[NUM_LIGHT_SENSORS];
+    for (int index = 0; index < POWER_SET_SIZE; index++)
+    {
+        if (simulatedSweep(index, readings) <= maximum)
+            return index;
+    }
+    return POWER_SET_SIZE - 1;
+}
+
+void setUp() { sweeps = 0; }
+void tearDown() {}
+
+void test_bisection_matches_linear_search()
+{
+    const int MAXIMUM = 750;
+
+    // From a dark room, where even the highest resistance is not enough, to light that clips at every resistance but 0 Ohm
+    for (float level = 100; level < 1e8f; level *= 1.3f)
+    {
+        brightness[0] = level;
+        brightness[1] = level * 0.6f;
+        brightness[2] = level * 1.4f;
+
+        int expected = linearSearch(MAXIMUM);
+
+        sweeps = 0;
+        int readings[NUM_LIGHT_SENSORS];
+        int index = bisectPowerSet(simulatedSweep, MAXIMUM, readings);
+
+        TEST_ASSERT_EQUAL_INT(expected, index);
+        TEST_ASSERT_LESS_OR_EQUAL(4, sweeps);
+
+        // Read at the result, or predicted from the neighbour when no resistance is low enough
+        for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+            TEST_ASSERT_EQUAL_INT(simulatedReading(i, index), readings[i]);
+    }
+}
+
+void test_every_result_index_is_reachable()
+{
+    // Light levels right at the threshold of each entry, so the search ends on every index of the power set
+    const int MAXIMUM = 750;
+    for (int target = 0; target < POWER_SET_SIZE; target++)
+    {
+        float level = target == 0 ? MAXIMUM : MAXIMUM * powerSet.values[0] / powerSet.values[target] - 1;
+        for (int i = 0; i < NUM_LIGHT_SENSORS; i++)
+            brightness[i] = level;
+
+        int expected = linearSearch(MAXIMUM);
+
+        sweeps = 0;
+        int readings[NUM_LIGHT_SENSORS];
+        TEST_ASSERT_EQUAL_INT(expected, bisectPowerSet(simulatedSweep, MAXIMUM, readings));
+        TEST_ASSERT_LESS_OR_EQUAL(4, sweeps);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bisection_matches_linear_search);
+    RUN_TEST(test_every_result_index_is_reachable);
+    return UNITY_END();
+}
\ No newline at end of file
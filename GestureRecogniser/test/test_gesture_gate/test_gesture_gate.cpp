@@ -0,0 +1,96 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "gesture_gate.hpp"
+
+static CaptureBuffer capture;
+
+// Every light sensor at its baseline, with a dip of depth (a fraction of the baseline) centred on sample centre
+static void fill(float baseline, float depth, int centre)
+{
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+        {
+            float t = (float) j - centre - 10 * (int) i;
+            float shadow = depth * expf(-t * t / 100);
+            CaptureLayout::At(capture, i, j) = (uint16_t) (baseline * (1 - shadow) + rand() % 5 - 2);
+        }
+    }
+}
+
+void setUp() { srand(5); }
+void tearDown() {}
+
+void test_accepts_a_gesture()
+{
+    GestureGate gate;
+    fill(600, 0.6f, 40);
+    TEST_ASSERT_EQUAL_INT(GATE_ACCEPTED, gate.check(capture));
+    TEST_ASSERT_EQUAL_UINT32(1, gate.getAccepted());
+    TEST_ASSERT_EQUAL_UINT32(0, gate.getRejected());
+}
+
+void test_rejects_a_clipped_capture()
+{
+    GestureGate gate;
+    fill(1023, 0.6f, 40);
+    TEST_ASSERT_EQUAL_INT(GATE_REJECTED_SATURATED, gate.check(capture));
+    TEST_ASSERT_EQUAL_UINT32(1, gate.getRejected());
+}
+
+void test_rejects_sensor_noise()
+{
+    GestureGate gate;
+    fill(600, 0, 40);
+    TEST_ASSERT_EQUAL_INT(GATE_REJECTED_LOW_ENERGY, gate.check(capture));
+}
+
+void test_rejects_a_dark_capture()
+{
+    // No light at all, the relative measures have nothing to compare against
+    GestureGate gate;
+    memset(capture, 0, sizeof(capture));
+    TEST_ASSERT_EQUAL_INT(GATE_REJECTED_LOW_ENERGY, gate.check(capture));
+}
+
+void test_rejects_an_ambient_light_change()
+{
+    GestureGate gate;
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+            CaptureLayout::At(capture, i, j) = j < 50 ? 700 : 300;
+    }
+    TEST_ASSERT_EQUAL_INT(GATE_REJECTED_STEP, gate.check(capture));
+}
+
+void test_checks_only_the_given_length()
+{
+    // The dip is past the first 60 samples, which are noise only
+    GestureGate gate;
+    fill(600, 0.6f, 75);
+    TEST_ASSERT_EQUAL_INT(GATE_REJECTED_LOW_ENERGY, gate.check(capture, 40));
+    TEST_ASSERT_EQUAL_INT(GATE_ACCEPTED, gate.check(capture));
+}
+
+void test_result_names()
+{
+    TEST_ASSERT_EQUAL_STRING("accepted", gateResultName(GATE_ACCEPTED));
+    TEST_ASSERT_EQUAL_STRING("ambient light change", gateResultName(GATE_REJECTED_STEP));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_accepts_a_gesture);
+    RUN_TEST(test_rejects_a_clipped_capture);
+    RUN_TEST(test_rejects_sensor_noise);
+    RUN_TEST(test_rejects_a_dark_capture);
+    RUN_TEST(test_rejects_an_ambient_light_change);
+    RUN_TEST(test_checks_only_the_given_length);
+    RUN_TEST(test_result_names);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+// SSE2 on the host and the DSP extension on the board (pio test -e nano33ble), both against the scalar kernels
+#include "../kernel_checks.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    // Gives the serial monitor time to connect before the results are printed
+    delay(2000);
+    runKernelTests();
+}
+
+void loop() {}
+#else
+int main()
+{
+    return runKernelTests();
+}
+#endif // ARDUINO
\ No newline at end of file
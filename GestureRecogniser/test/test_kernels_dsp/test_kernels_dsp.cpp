@@ -0,0 +1,9 @@
+// The DSP kernels on the host, with the intrinsics of test/native/cmsis_compiler.h. Not run on the board, where
+// test_kernels already covers them with the real instructions.
+#define __ARM_FEATURE_DSP 1
+#include "../kernel_checks.h"
+
+int main()
+{
+    return runKernelTests();
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pre-processing/preprocessor.hpp"
+
+// Golden vectors of the fast pipeline, the reference for Model/batch_preprocessing.py (Model/tests).
+// Regenerate them after an intended change of the pre-processing with
+// pio test -e native -f test_preprocessing_golden -a --update-golden
+//
+// File layout, little endian: "PPGV", the number of captures, channels and samples per channel as uint32,
+// the sample rate and cutoff of the low pass filter as float, then every raw capture as uint16 and every output
+// as float, both planar (channels x samples).
+
+typedef BasicPreprocessor<PlanarLayout> PlanarPreprocessor;
+
+static const uint32_t GOLDEN_CAPTURES = 32;
+static const float GOLDEN_SAMPLE_RATE = 1000.0f / READ_PERIOD;
+
+struct GoldenHeader
+{
+    char magic[4];
+    uint32_t captures;
+    uint32_t channels;
+    uint32_t length;
+    float sampleRate;
+    float cutoff;
+};
+
+static bool updateGolden = false;
+
+static PlanarPreprocessor::Capture captures[GOLDEN_CAPTURES];
+static PlanarPreprocessor::Output outputs[GOLDEN_CAPTURES];
+
+// Hands of different sizes and speeds over different baselines, and the edge cases of the standardisation:
+// a capture without change, a dark channel, a clipped channel and noise only
+static void generateCaptures()
+{
+    srand(17);
+    for (uint32_t c = 0; c < GOLDEN_CAPTURES; c++)
+    {
+        const float depth = 0.2f + 0.6f * (rand() % 100) / 100;
+        const float width = 50 + rand() % 400;
+        const int start = 15 + rand() % 40;
+        const int delay = (rand() % 31) - 15;
+        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+        {
+            const int baseline = 200 + rand() % 700;
+            for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+            {
+                float t = (float) j - start - delay * (int) i;
+                float shadow = depth * expf(-t * t / width);
+                int x = (int) (baseline * (1 - shadow)) + rand() % 9 - 4;
+                captures[c][i][j] = (uint16_t) (x < 0 ? 0 : x > ADC_MAX_READING ? ADC_MAX_READING : x);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+        {
+            captures[0][i][j] = 600 + 100 * i;
+            captures[2][i][j] = ADC_MAX_READING - rand() % 3;
+            captures[3][i][j] = 500 + rand() % 9;
+        }
+    }
+    memset(captures[1][1], 0, sizeof(captures[1][1]));
+}
+
+static void runCaptures()
+{
+    static PlanarPreprocessor preprocessor;
+    preprocessor.setLowPassFilter(GOLDEN_SAMPLE_RATE, LOW_PASS_CUTOFF);
+    for (uint32_t c = 0; c < GOLDEN_CAPTURES; c++)
+    {
+        preprocessor.runFastPipeline(captures[c]);
+        memcpy(outputs[c], preprocessor.getPipelineOutput(), sizeof(outputs[c]));
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_fast_pipeline_matches_golden_vectors()
+{
+    // The batch engine does not resample, so the golden vectors only exist for captures of the model length
+    TEST_ASSERT_EQUAL_MESSAGE(NUM_DATAPOINTS, GESTURE_BUFFER_LENGTH, "Golden vectors need captures of NUM_DATAPOINTS samples");
+
+    if (updateGolden)
+    {
+        generateCaptures();
+        runCaptures();
+
+        FILE* file = fopen(PREPROCESSING_GOLDEN_FILE, "wb");
+        TEST_ASSERT_TRUE_MESSAGE(file != NULL, "Cannot write " PREPROCESSING_GOLDEN_FILE);
+        GoldenHeader header = {{'P', 'P', 'G', 'V'}, GOLDEN_CAPTURES, NUM_LIGHT_SENSORS, NUM_DATAPOINTS, GOLDEN_SAMPLE_RATE, LOW_PASS_CUTOFF};
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(captures, sizeof(captures), 1, file);
+        fwrite(outputs, sizeof(outputs), 1, file);
+        fclose(file);
+        return;
+    }
+
+    FILE* file = fopen(PREPROCESSING_GOLDEN_FILE, "rb");
+    TEST_ASSERT_TRUE_MESSAGE(file != NULL, "Cannot read " PREPROCESSING_GOLDEN_FILE);
+    GoldenHeader header;
+    static PlanarPreprocessor::Output golden[GOLDEN_CAPTURES];
+    bool complete = fread(&header, sizeof(header), 1, file) == 1 && fread(captures, sizeof(captures), 1, file) == 1 &&
+                    fread(golden, sizeof(golden), 1, file) == 1;
+    fclose(file);
+    TEST_ASSERT_TRUE_MESSAGE(complete, "Golden vectors of another size, regenerate them");
+    TEST_ASSERT_EQUAL_MEMORY("PPGV", header.magic, 4);
+    TEST_ASSERT_EQUAL_UINT32(GOLDEN_CAPTURES, header.captures);
+
+    // Bit for bit, the host build does not fuse multiply-adds
+    runCaptures();
+    for (uint32_t c = 0; c < GOLDEN_CAPTURES; c++)
+        TEST_ASSERT_EQUAL_MEMORY(golden[c], outputs[c], sizeof(outputs[c]));
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+        updateGolden |= strcmp(argv[i], "--update-golden") == 0;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_fast_pipeline_matches_golden_vectors);
+    return UNITY_END();
+}
\ No newline at end of file
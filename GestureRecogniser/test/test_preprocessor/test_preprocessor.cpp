@@ -0,0 +1,190 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "pre-processing/preprocessor.hpp"
+
+typedef BasicPreprocessor<PlanarLayout> PlanarPreprocessor;
+typedef BasicPreprocessor<InterleavedLayout> InterleavedPreprocessor;
+
+// The fast pipeline rounds in another order than the reference, the output is standardised so around 1
+static const float FAST_TOLERANCE = 1e-4f;
+
+static PlanarPreprocessor::Capture capture;
+
+// A hand passing over the light sensors one after the other, with sensor noise
+static void syntheticGesture(PlanarPreprocessor::Capture& raw)
+{
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        const int baseline = 600 + 100 * i;
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+        {
+            float t = (float) j - 30 - 15 * i;
+            float shadow = 0.7f * expf(-t * t / 200);
+            raw[i][j] = (uint16_t) (baseline * (1 - shadow) + rand() % 9 - 4);
+        }
+    }
+}
+
+void setUp()
+{
+    srand(3);
+    syntheticGesture(capture);
+}
+
+void tearDown() {}
+
+void test_fast_pipeline_matches_reference()
+{
+    static PlanarPreprocessor reference;
+    static PlanarPreprocessor fast;
+    reference.runReferencePipeline(capture);
+    fast.runFastPipeline(capture);
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+            TEST_ASSERT_FLOAT_WITHIN(FAST_TOLERANCE, reference.getPipelineOutput()[i][j], fast.getPipelineOutput()[i][j]);
+    }
+}
+
+void test_reference_output_is_standardised()
+{
+    static PlanarPreprocessor preprocessor;
+    preprocessor.runReferencePipeline(capture);
+
+    // The low pass filter comes after the z-score, so the output is only close to a mean of 0 and a deviation of 1
+    double sum = 0;
+    double sumSquares = 0;
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+        {
+            float x = preprocessor.getPipelineOutput()[i][j];
+            TEST_ASSERT_FLOAT_IS_NOT_NAN(x);
+            sum += x;
+            sumSquares += x * x;
+        }
+    }
+    double mean = sum / (NUM_LIGHT_SENSORS * NUM_DATAPOINTS);
+    double deviation = sqrt(sumSquares / (NUM_LIGHT_SENSORS * NUM_DATAPOINTS) - mean * mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.0f, mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 1.0f, deviation);
+}
+
+void test_stream_matches_fast_pipeline()
+{
+    static PlanarPreprocessor batch;
+    static PlanarPreprocessor stream;
+    batch.runFastPipeline(capture);
+
+    for (uint16_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+    {
+        uint16_t sample[NUM_LIGHT_SENSORS];
+        for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+            sample[i] = capture[i][j];
+        stream.feedSample(sample, j);
+    }
+    TEST_ASSERT_TRUE(stream.isStreamComplete());
+    stream.finalizeStream();
+    TEST_ASSERT_FALSE(stream.isStreamComplete());
+
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+            TEST_ASSERT_FLOAT_WITHIN(FAST_TOLERANCE, batch.getPipelineOutput()[i][j], stream.getPipelineOutput()[i][j]);
+    }
+}
+
+void test_missed_sample_invalidates_stream()
+{
+    static PlanarPreprocessor stream;
+    uint16_t sample[NUM_LIGHT_SENSORS] = {500, 600, 700};
+    for (uint16_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+    {
+        if (j != 50)
+            stream.feedSample(sample, j);
+    }
+    TEST_ASSERT_FALSE(stream.isStreamComplete());
+
+    // A new capture starts over
+    for (uint16_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+        stream.feedSample(sample, j);
+    TEST_ASSERT_TRUE(stream.isStreamComplete());
+}
+
+void test_layouts_give_the_same_output()
+{
+    static InterleavedPreprocessor::Capture interleaved;
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+            interleaved[j][i] = capture[i][j];
+    }
+
+    static PlanarPreprocessor planar;
+    static InterleavedPreprocessor frames;
+
+    // The same operations on every sample, only the order in memory differs
+    planar.runReferencePipeline(capture);
+    frames.runReferencePipeline(interleaved);
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+            TEST_ASSERT_EQUAL_MEMORY(&planar.getPipelineOutput()[i][j], &frames.getPipelineOutput()[j][i], sizeof(float));
+    }
+
+    planar.runFastPipeline(capture);
+    frames.runFastPipeline(interleaved);
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+            TEST_ASSERT_EQUAL_MEMORY(&planar.getPipelineOutput()[i][j], &frames.getPipelineOutput()[j][i], sizeof(float));
+    }
+}
+
+void test_constant_capture_stays_finite()
+{
+    // No light change at all, the z-score has no deviation to divide by
+    static PlanarPreprocessor::Capture flat;
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < GESTURE_BUFFER_LENGTH; j++)
+            flat[i][j] = 600 + 100 * i;
+    }
+
+    static PlanarPreprocessor fast;
+    fast.runFastPipeline(flat);
+    for (size_t i = 0; i < NUM_LIGHT_SENSORS; i++)
+    {
+        for (size_t j = 0; j < NUM_DATAPOINTS; j++)
+        {
+            float x = fast.getPipelineOutput()[i][j];
+            TEST_ASSERT_FLOAT_IS_NOT_NAN(x);
+            TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.0f, x);
+        }
+    }
+}
+
+void test_low_pass_cutoff_must_be_below_nyquist()
+{
+    static PlanarPreprocessor preprocessor;
+    TEST_ASSERT_FALSE(preprocessor.setLowPassFilter(100, 50));
+    TEST_ASSERT_FALSE(preprocessor.setLowPassFilter(100, 0));
+    TEST_ASSERT_TRUE(preprocessor.setLowPassFilter(100, 10));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fast_pipeline_matches_reference);
+    RUN_TEST(test_reference_output_is_standardised);
+    RUN_TEST(test_stream_matches_fast_pipeline);
+    RUN_TEST(test_missed_sample_invalidates_stream);
+    RUN_TEST(test_layouts_give_the_same_output);
+    RUN_TEST(test_constant_capture_stays_finite);
+    RUN_TEST(test_low_pass_cutoff_must_be_below_nyquist);
+    return UNITY_END();
+}
\ No newline at end of file
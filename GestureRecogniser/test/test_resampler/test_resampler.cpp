@@ -0,0 +1,196 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "pre-processing/pipeline/Resampler.h"
+
+void setUp() { srand(11); }
+void tearDown() {}
+
+void test_equal_lengths_copy_the_signal()
+{
+    const Resampler::Mode modes[] = {Resampler::LINEAR, Resampler::POLYPHASE};
+    for (Resampler::Mode mode : modes)
+    {
+        uint16_t input[100];
+        uint16_t output[100];
+        for (int n = 0; n < 100; n++)
+            input[n] = rand() % 1024;
+
+        Resampler resampler(mode);
+        resampler.Resample(input, 100, output, 100);
+
+        TEST_ASSERT_EQUAL_UINT16_ARRAY(input, output, 100);
+    }
+}
+
+void test_constant_signal_stays_constant()
+{
+    const Resampler::Mode modes[] = {Resampler::LINEAR, Resampler::POLYPHASE};
+    const int lengths[] = {1, 40, 100, 160};
+    for (Resampler::Mode mode : modes)
+    {
+        for (int inputLength : lengths)
+        {
+            uint16_t input[160];
+            uint16_t output[100];
+            for (int n = 0; n < inputLength; n++)
+                input[n] = 1023;
+
+            Resampler resampler(mode);
+            resampler.Resample(input, inputLength, output, 100);
+
+            for (int j = 0; j < 100; j++)
+                TEST_ASSERT_EQUAL_UINT16(1023, output[j]);
+        }
+    }
+}
+
+void test_linear_follows_a_ramp()
+{
+    // Stretched from 34 to 100 samples, the exact positions fall between the input samples
+    uint16_t input[34];
+    uint16_t output[100];
+    for (int n = 0; n < 34; n++)
+        input[n] = 10 * n;
+
+    Resampler resampler(Resampler::LINEAR);
+    resampler.Resample(input, 34, output, 100);
+
+    // The 16.16 phase truncates, so the output can be one step below the exact ramp
+    for (int j = 0; j < 100; j++)
+    {
+        float exact = 10.0f * j * 33 / 99;
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, exact - 0.5f, output[j]);
+    }
+}
+
+void test_polyphase_keeps_slow_signals()
+{
+    // A sine far below the cutoff of the shortened signal passes nearly unchanged
+    uint16_t input[200];
+    uint16_t output[100];
+    for (int n = 0; n < 200; n++)
+        input[n] = (uint16_t) lroundf(512 + 400 * sinf(2 * M_PI * n / 100));
+
+    Resampler resampler(Resampler::POLYPHASE);
+    resampler.Resample(input, 200, output, 100);
+
+    for (int j = 0; j < 100; j++)
+    {
+        float exact = 512 + 400 * sinf(2 * M_PI * j * 199.0f / 99 / 100);
+        TEST_ASSERT_FLOAT_WITHIN(8.0f, exact, output[j]);
+    }
+}
+
+void test_polyphase_removes_what_would_alias()
+{
+    // Alternating samples are at the Nyquist frequency of the input, far above that of the halved signal
+    uint16_t input[200];
+    uint16_t output[100];
+    for (int n = 0; n < 200; n++)
+        input[n] = n % 2 ? 600 : 400;
+
+    Resampler linear(Resampler::LINEAR);
+    linear.Resample(input, 200, output, 100);
+    int linearSwing = 0;
+    for (int j = 10; j < 90; j++)
+        if (abs(output[j] - 500) > linearSwing)
+            linearSwing = abs(output[j] - 500);
+
+    Resampler polyphase(Resampler::POLYPHASE);
+    polyphase.Resample(input, 200, output, 100);
+    int polyphaseSwing = 0;
+    for (int j = 10; j < 90; j++)
+        if (abs(output[j] - 500) > polyphaseSwing)
+            polyphaseSwing = abs(output[j] - 500);
+
+    TEST_ASSERT_GREATER_THAN(50, linearSwing);
+    TEST_ASSERT_LESS_THAN(linearSwing / 2, polyphaseSwing);
+}
+
+void test_end_points_line_up()
+{
+    const Resampler::Mode modes[] = {Resampler::LINEAR, Resampler::POLYPHASE};
+    const int lengths[] = {2, 37, 100, 250};
+    for (Resampler::Mode mode : modes)
+    {
+        for (int inputLength : lengths)
+        {
+            // The anti-aliasing filter of a shortened signal also smooths its first and last samples
+            if (mode == Resampler::POLYPHASE && inputLength > 100)
+                continue;
+
+            uint16_t input[250];
+            uint16_t output[100];
+            for (int n = 0; n < inputLength; n++)
+                input[n] = 100 + 3 * n;
+
+            Resampler resampler(mode);
+            resampler.Resample(input, inputLength, output, 100);
+
+            TEST_ASSERT_EQUAL_UINT16(input[0], output[0]);
+            TEST_ASSERT_EQUAL_UINT16(input[inputLength - 1], output[99]);
+        }
+    }
+}
+
+void test_linear_handles_full_scale_steps()
+{
+    // A difference of more than 15 bits times the 16 bit fraction overflows 32 bits.
+    // The phase and the product both truncate, so a rising output can be up to two steps below the exact line
+    // and a falling output up to one step on either side of it.
+    uint16_t input[2] = {0, UINT16_MAX};
+    uint16_t output[100];
+
+    Resampler resampler(Resampler::LINEAR);
+    resampler.Resample(input, 2, output, 100);
+
+    for (int j = 0; j < 100; j++)
+    {
+        float exact = (float) UINT16_MAX * j / 99;
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, exact - 1.0f, output[j]);
+    }
+
+    input[0] = UINT16_MAX;
+    input[1] = 0;
+    resampler.Resample(input, 2, output, 100);
+    for (int j = 0; j < 100; j++)
+    {
+        float exact = UINT16_MAX - (float) UINT16_MAX * j / 99;
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, exact, output[j]);
+    }
+}
+
+void test_reconfigures_when_the_lengths_change()
+{
+    uint16_t input[150];
+    uint16_t reused[100];
+    uint16_t fresh[100];
+    for (int n = 0; n < 150; n++)
+        input[n] = rand() % 1024;
+
+    Resampler resampler(Resampler::POLYPHASE);
+    resampler.Resample(input, 60, reused, 100);
+    resampler.Resample(input, 150, reused, 100);
+
+    Resampler other(Resampler::POLYPHASE);
+    other.Resample(input, 150, fresh, 100);
+
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(fresh, reused, 100);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_equal_lengths_copy_the_signal);
+    RUN_TEST(test_constant_signal_stays_constant);
+    RUN_TEST(test_linear_follows_a_ramp);
+    RUN_TEST(test_polyphase_keeps_slow_signals);
+    RUN_TEST(test_polyphase_removes_what_would_alias);
+    RUN_TEST(test_end_points_line_up);
+    RUN_TEST(test_linear_handles_full_scale_steps);
+    RUN_TEST(test_reconfigures_when_the_lengths_change);
+    return UNITY_END();
+}
\ No newline at end of file
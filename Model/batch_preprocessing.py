@@ -0,0 +1,161 @@
+# This python file pre-processes many captures at once with the same single precision operations, in the same order,
+# as Preprocessor::runPipeline of the GestureRecogniser firmware (FAST_MATH_PREPROCESSING), so whole datasets can be
+# prepared offline exactly like the microcontroller prepares its captures.
+
+import os
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+# Windows per chunk, a time step of a chunk (channels x windows floats) stays in the L1 cache
+CHUNK_WINDOWS = 1024
+
+def low_pass_coefficients(sample_rate: float = 100, cutoff: float = 25) -> tuple:
+    """
+    Butterworth::LowPass followed by Preprocessor::setLowPassFilter, in single precision: the feedforward coefficient
+    and the two feedback coefficients of the all-pole section the model is trained on.
+
+    Returns:
+        A tuple (b0, a1, a2) of np.float32.
+    """
+    f32 = np.float32
+    sample_rate, cutoff = f32(sample_rate), f32(cutoff)
+
+    wc = f32(2) * f32(np.pi) * cutoff
+    k = f32(2) * sample_rate
+
+    wc2 = wc * wc
+    k2 = k * k
+    damping = f32(np.sqrt(2)) * wc * k
+
+    norm = f32(1) / (k2 + damping + wc2)
+
+    b0 = wc2 * norm
+    b1 = f32(2) * b0
+    b2 = b0
+    a0 = f32(2) * (k2 - wc2) * norm
+    a1 = -(k2 - damping + wc2) * norm
+
+    return b0, a0 + b1, a1 + b2
+
+def rsqrt(x: np.ndarray) -> np.ndarray:
+    """
+    FastMath::Rsqrt for every element: the exponent trick followed by two Newton-Raphson steps.
+    """
+    x = np.asarray(x, dtype=np.float32)
+    y = (np.uint32(0x5F375A86) - (x.view(np.uint32) >> np.uint32(1))).view(np.float32)
+
+    half_x = np.float32(0.5) * x
+    for _ in range(2):
+        y = y * (np.float32(1.5) - half_x * y * y)
+    return y
+
+def standardisation(raw: np.ndarray) -> tuple:
+    """
+    Kernels::Statistics and Standardise::Compute for a chunk of captures.
+
+    Args:
+        raw (np.ndarray): Integer samples with shape (time, channels, windows).
+
+    Returns:
+        The gain of every channel of every window with shape (channels, windows), and the offset of every window.
+    """
+    f32 = np.float32
+    length, channels = raw.shape[0], raw.shape[1]
+
+    # The sums are exact integers, like on the device
+    wide = raw.astype(np.int64)
+    maximum = raw.max(axis=0)
+    total = wide.sum(axis=0)
+    spread = length * np.einsum('tcw,tcw->cw', wide, wide) - total * total
+
+    inv_length = f32(1) / f32(length)
+
+    scale = np.where(maximum == 0, f32(1), f32(1) / np.maximum(maximum, 1).astype(f32))
+    channel_mean = total.astype(f32) * inv_length * scale
+
+    # Accumulated channel after channel, in the order of the firmware
+    mean = np.zeros(raw.shape[2], dtype=f32)
+    for i in range(channels):
+        mean += channel_mean[i]
+    mean *= f32(1) / f32(channels)
+
+    variance = np.zeros(raw.shape[2], dtype=f32)
+    for i in range(channels):
+        channel_variance = spread[i].astype(f32) * inv_length * inv_length * scale[i] * scale[i]
+        difference = channel_mean[i] - mean
+        variance += channel_variance + difference * difference
+    variance *= f32(1) / f32(channels)
+
+    # Bounded like Standardise::Compute, a capture without any change has no variance
+    variance = np.maximum(variance, f32(1e-6))
+
+    inv_std = rsqrt(variance)
+    return scale * inv_std, mean * inv_std
+
+def preprocess_chunk(raw: np.ndarray, coefficients: tuple) -> np.ndarray:
+    """
+    Standardise and ModelLowPass for a chunk of captures. Every step works on all windows of the chunk at once,
+    the windows are the innermost axis so that each one is a lane of the vector instructions.
+
+    Args:
+        raw (np.ndarray): Integer samples with shape (time, channels, windows).
+        coefficients (tuple): The low pass filter from low_pass_coefficients.
+
+    Returns:
+        np.ndarray: The pre-processed samples as float32, with the same shape.
+    """
+    b0, a1, a2 = coefficients
+    zero = np.float32(0)
+
+    gain, offset = standardisation(raw)
+    signal = raw.astype(np.float32) * gain + (-offset)
+
+    # The first two samples pass through and prime the state of the transposed direct form II section.
+    # The products with the zero feedforward coefficients are kept, they decide the sign of zero like on the device.
+    s1 = a1 * signal[1] + a2 * signal[0]
+    s2 = a2 * signal[1]
+    for n in range(2, signal.shape[0]):
+        x = signal[n]
+        y = b0 * x + s1
+        s1 = zero * x + a1 * y + s2
+        s2 = zero * x + a2 * y
+        signal[n] = y
+
+    return signal
+
+def preprocess_batch(captures: np.ndarray, sample_rate: float = 100, cutoff: float = 25, workers: int = None) -> np.ndarray:
+    """
+    Pre-processes captures the way Preprocessor::runPipeline does, bit for bit with a build of the firmware that
+    does not fuse multiply-adds (on the Cortex-M4 the compiler contracts them, which changes the last bit at most).
+    The captures are split into chunks that are processed in parallel, numpy releases the GIL while it computes.
+
+    Args:
+        captures (np.ndarray): Raw ADC readings with shape (windows, NUM_DATAPOINTS, NUM_LIGHT_SENSORS), rounded to
+            the integers the device reads.
+        sample_rate (float): Sample rate in Hz, 1000 / READ_PERIOD.
+        cutoff (float): Cutoff frequency of the low pass filter in Hz, LOW_PASS_CUTOFF.
+        workers (int): Number of threads, all cores by default.
+
+    Returns:
+        np.ndarray: The pre-processed captures as float32, with the same shape.
+    """
+    captures = np.asarray(captures)
+    if captures.ndim != 3:
+        raise ValueError(f"Expected captures with shape (windows, time, channels), got {captures.shape}")
+
+    raw = np.clip(np.round(captures), 0, np.iinfo(np.uint16).max).astype(np.uint16)
+    coefficients = low_pass_coefficients(sample_rate, cutoff)
+
+    result = np.empty(raw.shape, dtype=np.float32)
+
+    def run(start: int):
+        chunk = raw[start:start + CHUNK_WINDOWS]
+        # Structure of arrays: (time, channels, windows)
+        soa = np.ascontiguousarray(chunk.transpose(1, 2, 0))
+        result[start:start + CHUNK_WINDOWS] = preprocess_chunk(soa, coefficients).transpose(2, 0, 1)
+
+    with ThreadPoolExecutor(max_workers=workers or os.cpu_count()) as executor:
+        list(executor.map(run, range(0, raw.shape[0], CHUNK_WINDOWS)))
+
+    return result
\ No newline at end of file
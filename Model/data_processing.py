@@ -93,18 +93,48 @@ def low_pass_filter(data: list, band_limit: int, sampling_rate: int = 100):
     F[cutoff_index + 1:] = 0
     return np.fft.irfft(F, n=data.size).real
 
-def butterworth_filter(data: list):
+def butterworth_coefficients(sample_rate: float = 100, cutoff: float = 25) -> tuple:
+    """
+    Designs a 2nd order Butterworth low pass filter with the bilinear transform, without prewarping the cutoff.
+    Reference for Butterworth::LowPass in GestureRecogniser/src/pre-processing/pipeline/Butterworth.h.
+
+    Args:
+        sample_rate (float, optional): The sampling rate of the data in Hz. Defaults to 100.
+        cutoff (float, optional): The cutoff frequency in Hz. Defaults to 25.
+
+    Returns:
+        tuple: The feedback coefficients a and the feedforward coefficients b,
+            with a in the sign convention of the formula in butterworth_filter.
+    """
+
+    # Ensure the cutoff is less than half the sampling rate
+    assert 0 < cutoff < sample_rate / 2, "Cutoff must be between 0 and half the sampling rate."
+
+    # Analog prototype H(s) = wc^2 / (s^2 + sqrt(2) * wc * s + wc^2), with s = k * (1 - z^-1) / (1 + z^-1)
+    wc = 2 * np.pi * cutoff
+    k = 2 * sample_rate
+    damping = np.sqrt(2) * wc * k
+    norm = k * k + damping + wc * wc
+
+    b0 = wc * wc / norm
+    a = [2 * (k * k - wc * wc) / norm, -(k * k - damping + wc * wc) / norm]
+    b = [b0, 2 * b0, b0]
+
+    return a, b
+
+def butterworth_filter(data: list, sample_rate: float = 100, cutoff: float = 25):
     """
     Applies a butterworth filter to the data.
 
     Args:	
         data (list): The data to be filtered.	
+        sample_rate (float, optional): The sampling rate of the data in Hz. Defaults to 100.
+        cutoff (float, optional): The cutoff frequency in Hz. Defaults to 25.
     """
 
     # Coefficients for a 2nd order Butterworth filter
-    # Calculated using sample rate of 100 Hz and cutoff frequency of 25 Hz
-    a = [0.28094574, -0.18556054]
-    b = [0.2261537, 0.4523074, 0.2261537] 
+    # For a sample rate of 100 Hz and cutoff frequency of 25 Hz: a = [0.28094574, -0.18556054], b = [0.2261537, 0.4523074, 0.2261537]
+    a, b = butterworth_coefficients(sample_rate, cutoff)
 
     # Formula for 2nd order Butterworth filter, where a and b are the coefficients and x and y are the input and output respectively
     # y[n] = a[0] * y[n-1] + a[1] * y[n-2] + b[0] * x[n] + b[1] * x[n-1] + b[2] * x[n-2]
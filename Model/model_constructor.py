@@ -1,8 +1,11 @@
 from enum import Enum
 import tensorflow as tf
 import keras.layers as layers
+import numpy as np
 
 import data_processing
+import model_convertor
+from data_loading import GestureNames
 
 def experimental(input_shape: tuple, num_classes: int) -> list:
     """
@@ -196,6 +199,57 @@ def fcn(input_shape: tuple, num_classes: int) -> list:
         tf.keras.layers.Dense(units=num_classes, activation='softmax', name="predictions")
     ] 
 
+### Models for the hierarchical classifier ###
+
+def family_net(input_shape: tuple, num_classes: int) -> list:
+    """
+    Tiny model that only classifies the gesture family (swipe, circle, tap or zoom).
+
+    """
+    return [
+        tf.keras.layers.Conv2D(filters=8, kernel_size=(3, 1), strides=(1, 1), padding='same', activation="relu"),
+        tf.keras.layers.MaxPooling2D(pool_size=(2, 2), strides=(2, 1), padding='valid'),
+
+        tf.keras.layers.Conv2D(filters=16, kernel_size=(2, 2), strides=(1, 1), padding='valid', activation="relu"),
+        tf.keras.layers.MaxPooling2D(pool_size=(2, 2), strides=(2, 1), padding='valid'),
+
+        tf.keras.layers.Flatten(),
+
+        tf.keras.layers.Dense(units=32, activation='relu'),
+        tf.keras.layers.Dropout(rate=0.5),
+
+        tf.keras.layers.Dense(units=num_classes, activation='softmax', name="predictions")
+    ]
+
+def specialist_net(input_shape: tuple, num_classes: int) -> list:
+    """
+    Small model that classifies the gestures within a single family.
+
+    """
+    return [
+        tf.keras.layers.Conv2D(filters=16, kernel_size=(3, 1), strides=(1, 1), padding='same', activation="relu"),
+        tf.keras.layers.MaxPooling2D(pool_size=(2, 1), strides=(1, 1), padding='valid'),
+
+        tf.keras.layers.Conv2D(filters=16, kernel_size=(2, 2), strides=(1, 1), padding='valid', activation="relu"),
+        tf.keras.layers.MaxPooling2D(pool_size=(2, 2), strides=(2, 1), padding='same'),
+
+        tf.keras.layers.Flatten(),
+
+        tf.keras.layers.Dense(units=64, activation='relu'),
+        tf.keras.layers.Dropout(rate=0.5),
+
+        tf.keras.layers.Dense(units=num_classes, activation='softmax', name="predictions")
+    ]
+
+# Gesture families, in the same order as GESTURE_FAMILY_NAMES in GestureRecogniser/src/model/gestures.hpp.
+# The gestures of a family are consecutive in GestureNames.
+GESTURE_FAMILIES = {
+    "swipe": [GestureNames.SWIPE_LEFT, GestureNames.SWIPE_RIGHT, GestureNames.SWIPE_UP, GestureNames.SWIPE_DOWN],
+    "circle": [GestureNames.CIRCLE_CLOCKWISE, GestureNames.CIRCLE_COUNTER_CLOCKWISE],
+    "tap": [GestureNames.TAP, GestureNames.DOUBLE_TAP],
+    "zoom": [GestureNames.ZOOM_IN, GestureNames.ZOOM_OUT],
+}
+
 ### Models from last year (2022) ###
 
 def slam_cnn(input_shape: tuple, num_classes: int) -> list:
@@ -294,6 +348,8 @@ class ModelName(Enum):
     BEERNET_LITE = beernet_lite,
     BEERNET_EXPERIMENTAL = beernet_experimental,
     FCN = fcn,
+    FAMILY_NET = family_net,
+    SPECIALIST_NET = specialist_net,
 
 class ModelConstructor:
 
@@ -320,4 +376,154 @@ class ModelConstructor:
         for layer in layers:
             new_model.add(layer)
 
-        return new_model
\ No newline at end of file
+        return new_model
+
+    def get_hierarchical_models(input_shape: tuple, include_preprocessing: bool = True) -> dict:
+        """
+        Creates the models of the hierarchical classifier: one family model and one specialist model per gesture family.
+
+        :return: dictionary with the family model under "family" and the specialists under their family name
+        """
+        models = {"family": ModelConstructor.get_model(ModelName.FAMILY_NET, input_shape, len(GESTURE_FAMILIES), include_preprocessing)}
+
+        for family, gestures in GESTURE_FAMILIES.items():
+            models[family] = ModelConstructor.get_model(ModelName.SPECIALIST_NET, input_shape, len(gestures), include_preprocessing)
+
+        return models
+
+    def get_early_exit_model(input_shape: tuple, num_classes: int, include_preprocessing: bool = True) -> tuple:
+        """
+        BeerNet Lite with an auxiliary classifier head ("exit_1") after the first conv block.
+        Easy gestures can be classified by the head, so the rest of the network does not have to run.
+
+        :return: tuple of the trainable model with outputs [exit_1, predictions],
+                 the first stage (input -> [block 1 features, exit_1]) and the second stage (block 1 features -> predictions).
+                 The stages share their weights with the trainable model.
+        """
+        block_1 = [
+            tf.keras.layers.Conv2D(filters=16, kernel_size=(3, 1), strides=(1, 1), padding='same', activation="relu"),
+            tf.keras.layers.MaxPooling2D(pool_size=(2, 1), strides=(1, 1), padding='valid'),
+        ]
+
+        exit_head = [
+            # Squeeze the channels first to keep the head small
+            tf.keras.layers.Conv2D(filters=4, kernel_size=(1, 1), strides=(1, 1), padding='valid', activation="relu"),
+            tf.keras.layers.Flatten(),
+            tf.keras.layers.Dense(units=num_classes, activation='softmax', name="exit_1")
+        ]
+
+        # The remaining layers of BeerNet Lite
+        remaining = beernet_lite(input_shape, num_classes)[len(block_1):]
+
+        def apply(layers, x):
+            for layer in layers:
+                x = layer(x)
+            return x
+
+        inputs = tf.keras.Input(shape=input_shape, name="sensor_image")
+
+        x = inputs
+        if include_preprocessing:
+            x = apply(data_processing.preprocess_layers(input_shape), x)
+
+        features = apply(block_1, x)
+        exit_1 = apply(exit_head, features)
+        predictions = apply(remaining, features)
+
+        model = tf.keras.Model(inputs=inputs, outputs=[exit_1, predictions])
+
+        # The pre-processing layers are only active during training, so the stages can skip them
+        stage_1_inputs = tf.keras.Input(shape=input_shape, name="sensor_image")
+        stage_1_features = apply(block_1, stage_1_inputs)
+        stage_1 = tf.keras.Model(inputs=stage_1_inputs, outputs=[stage_1_features, apply(exit_head, stage_1_features)])
+
+        stage_2_inputs = tf.keras.Input(shape=features.shape[1:], name="block_1_features")
+        stage_2 = tf.keras.Model(inputs=stage_2_inputs, outputs=apply(remaining, stage_2_inputs))
+
+        return model, stage_1, stage_2
+
+def family_labels(labels: np.ndarray) -> np.ndarray:
+    """
+    Maps integer gesture labels (indices in GestureNames) to integer family labels (indices in GESTURE_FAMILIES).
+    """
+    gesture_classes = list(GestureNames)
+    families = list(GESTURE_FAMILIES.values())
+    family_of_gesture = [next(i for i, family in enumerate(families) if gesture in family) for gesture in gesture_classes]
+
+    return np.array([family_of_gesture[label] for label in labels])
+
+def export_hierarchical_models(data: np.ndarray, labels: np.ndarray, input_shape: tuple, epochs: int = 256, batch_size: int = 265,
+                               output_path: str = "../GestureRecogniser/src/model/hierarchical_model_data.cpp") -> dict:
+    """
+    Trains the family and specialist models on the pre-processed data with integer gesture labels,
+    quantizes them and exports the set as C arrays for the HIERARCHICAL_MODEL build of the microcontroller program.
+    The TFLite files ({name}_model.tflite) are kept as well for the replay harness.
+
+    :return: dictionary with the trained keras models
+    """
+    models = ModelConstructor.get_hierarchical_models(input_shape)
+    families = family_labels(labels)
+    gesture_classes = list(GestureNames)
+
+    source = "// Generated by export_hierarchical_models in model_constructor.py\n\n"
+    for name, model in models.items():
+        if name == "family":
+            model_data, model_labels = data, families
+        else:
+            family_index = list(GESTURE_FAMILIES.keys()).index(name)
+            family_gestures = [gesture_classes.index(gesture) for gesture in GESTURE_FAMILIES[name]]
+
+            mask = families == family_index
+            model_data = data[mask]
+            # Labels within the family start at zero, in the order of GESTURE_FAMILIES
+            model_labels = np.array([family_gestures.index(label) for label in labels[mask]])
+
+        model.compile(optimizer=tf.keras.optimizers.Adam(learning_rate=0.001),
+                      loss=tf.keras.losses.SparseCategoricalCrossentropy(),
+                      metrics=[tf.keras.metrics.SparseCategoricalAccuracy()])
+        model.fit(model_data, model_labels, batch_size=batch_size, epochs=epochs, verbose=0)
+
+        tflite_model = model_convertor.quantize_model(model, model_data)
+        with open(f"{name}_model.tflite", "wb") as f:
+            f.write(tflite_model)
+
+        source += model_convertor.to_c_array(tflite_model, f"{name}_model_tflite") + "\n"
+
+    with open(output_path, "w") as f:
+        f.write(source)
+
+    return models
+
+def export_early_exit_model(data: np.ndarray, labels: np.ndarray, input_shape: tuple, epochs: int = 768, batch_size: int = 265,
+                            exit_loss_weight: float = 0.5,
+                            output_path: str = "../GestureRecogniser/src/model/early_exit_model_data.cpp") -> tuple:
+    """
+    Trains the early exit model on the pre-processed data with integer gesture labels, quantizes both stages
+    and exports them as C arrays for the EARLY_EXIT_MODEL build of the microcontroller program.
+    The TFLite files (early_exit_stage_1.tflite and early_exit_stage_2.tflite) are kept as well for the replay harness.
+
+    :return: tuple of the trainable model and both stages
+    """
+    model, stage_1, stage_2 = ModelConstructor.get_early_exit_model(input_shape, len(GestureNames))
+
+    model.compile(optimizer=tf.keras.optimizers.Adam(learning_rate=0.001),
+                  loss=[tf.keras.losses.SparseCategoricalCrossentropy(), tf.keras.losses.SparseCategoricalCrossentropy()],
+                  loss_weights=[exit_loss_weight, 1.0],
+                  metrics=[tf.keras.metrics.SparseCategoricalAccuracy()])
+    model.fit(data, [labels, labels], batch_size=batch_size, epochs=epochs, verbose=0)
+
+    # The second stage is calibrated on the features the first stage produces
+    features = stage_1.predict(data, verbose=0)[0]
+
+    source = "// Generated by export_early_exit_model in model_constructor.py\n\n"
+    for name, stage, representative_data in (("early_exit_stage_1", stage_1, data), ("early_exit_stage_2", stage_2, features)):
+        tflite_model = model_convertor.quantize_model(stage, representative_data)
+        with open(f"{name}.tflite", "wb") as f:
+            f.write(tflite_model)
+
+        source += model_convertor.to_c_array(tflite_model, f"{name}_tflite") + "\n"
+
+    with open(output_path, "w") as f:
+        f.write(source)
+
+    return model, stage_1, stage_2
@@ -30,3 +30,20 @@ def quantize_model(model, representative_data, write_to_file = False):
         open("converted_model.tflite", "wb").write(tflite_model)
 
     return tflite_model
+
+def to_c_array(tflite_model, variable_name: str) -> str:
+    """
+    Formats a converted model as a C array, the same as ``xxd -i`` does for the model_data.cpp file.
+
+    Args:
+        tflite_model: The converted model.
+        variable_name (str): Name of the array in the C code.
+
+    Returns:
+        str: The C source code defining the array.
+    """
+    lines = []
+    for i in range(0, len(tflite_model), 12):
+        lines.append("  " + ", ".join(f"0x{byte:02x}" for byte in tflite_model[i:i + 12]))
+
+    return f"unsigned char {variable_name}[] = {{\n" + ",\n".join(lines) + f"\n}};\nunsigned int {variable_name}_len = {len(tflite_model)};\n"
@@ -0,0 +1,2 @@
+# The replay harness, one module per feature of the GestureRecogniser firmware. Every module has a report function that
+# replays the recorded gestures through its feature and prints the results, see replay_harness.py.
\ No newline at end of file
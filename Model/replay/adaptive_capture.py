@@ -0,0 +1,75 @@
+# Adaptive length capture: the capture ends when the end of the gesture is detected and is stretched onto the model
+# input (ADAPTIVE_CAPTURE).
+
+import numpy as np
+
+import data_loading
+
+from replay.common import (ADC_MAX_READING, DETECTION_END_WINDOW_LENGTH, MIN_CAPTURE_LENGTH, NUM_DATAPOINTS,
+                           PRE_TRIGGER_LENGTH, READ_PERIOD_MS, THRESHOLD_ADJ_BUFFER_LENGTH, TFLiteModel, detection_thresholds,
+                           end_thresholds, model_input)
+from replay.resampling import resample_capture
+
+def detect_gesture_end(capture: np.ndarray, thresholds: np.ndarray) -> int:
+    """
+    Returns the length of the capture when the end of the gesture is detected like GestureDetector::detectGestureEnd,
+    or the full length when it is not: every sensor at or above its end threshold (see end_thresholds) for
+    DETECTION_END_WINDOW_LENGTH samples, after at least MIN_CAPTURE_LENGTH samples.
+
+    Args:
+        thresholds: the start thresholds of the sensors, see detection_thresholds
+    """
+    above = capture >= end_thresholds(thresholds)
+    for length in range(MIN_CAPTURE_LENGTH, len(capture) + 1):
+        if np.all(above[length - DETECTION_END_WINDOW_LENGTH:length]):
+            return length
+    return len(capture)
+
+def evaluate_adaptive_capture(model: TFLiteModel, samples: list, labels: np.ndarray, seed: int = 1337) -> dict:
+    """
+    Ends every recorded gesture where the firmware would detect its end with ADAPTIVE_CAPTURE, and compares the time
+    from the trigger to the end of the capture with the fixed length capture, per gesture.
+    The accuracy of the model on the stretched captures shows whether it needs to be trained on them.
+    The thresholds are learned like the firmware does, from THRESHOLD_ADJ_BUFFER_LENGTH samples of ambient light before
+    the gesture. The recordings start at the edge trigger, so the ambient level is taken from the brightest samples.
+
+    Returns:
+        The median capture time after the trigger per gesture, for fixed and adaptive capture, and both accuracies.
+    """
+    gesture_names = [gesture.value for gesture in data_loading.GestureNames]
+    fixed_ms = (NUM_DATAPOINTS - PRE_TRIGGER_LENGTH) * READ_PERIOD_MS
+
+    rng = np.random.default_rng(seed)
+    capture_ms = []
+    fixed_correct = 0
+    adaptive_correct = 0
+    for sample, label in zip(samples, labels):
+        sample = np.asarray(sample, dtype=np.float32)
+        baseline = np.percentile(sample, 90, axis=0)
+        ambient = np.clip(baseline + rng.normal(0, 2, size=(THRESHOLD_ADJ_BUFFER_LENGTH, sample.shape[1])), 0, ADC_MAX_READING)
+        thresholds = detection_thresholds(ambient)
+
+        length = detect_gesture_end(sample, thresholds)
+        capture_ms.append((length - PRE_TRIGGER_LENGTH) * READ_PERIOD_MS)
+
+        fixed_correct += np.argmax(model.predict(model_input(sample))) == label
+        adaptive_correct += np.argmax(model.predict(model_input(resample_capture(sample, length)))) == label
+
+    capture_ms = np.array(capture_ms)
+    per_gesture = {name: np.median(capture_ms[labels == i]) for i, name in enumerate(gesture_names) if np.any(labels == i)}
+
+    return {
+        'fixed_capture_ms': fixed_ms,
+        'median_capture_ms': np.median(capture_ms),
+        'median_capture_ms_per_gesture': per_gesture,
+        'fixed_accuracy': fixed_correct / len(samples),
+        'adaptive_accuracy': adaptive_correct / len(samples),
+    }
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Adaptive length capture:")
+    adaptive = evaluate_adaptive_capture(model, samples, labels)
+    print(f"  median capture after the trigger {adaptive['median_capture_ms']:.0f} ms instead of {adaptive['fixed_capture_ms']} ms, "
+          f"accuracy {adaptive['adaptive_accuracy']:.4f} instead of {adaptive['fixed_accuracy']:.4f} (model trained on fixed captures)")
+    for name, capture_ms in adaptive['median_capture_ms_per_gesture'].items():
+        print(f"  {name}: {capture_ms:.0f} ms")
\ No newline at end of file
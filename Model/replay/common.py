@@ -0,0 +1,147 @@
+# Shared parts of the replay harness: the mirrored firmware constants, the TFLite model wrapper, the recorded gestures
+# and the pre-processing of a capture into the model input.
+
+import time
+
+import numpy as np
+import tensorflow as tf
+
+import data_loading
+import data_processing
+
+# Mirrors of the constants in GestureRecogniser/src/global_constants.hpp
+NUM_DATAPOINTS = 100
+READ_PERIOD_MS = 10
+LOW_PASS_CUTOFF = 25
+INPUT_SHAPE = (20, 5, 3)
+ADC_MAX_READING = 1023
+
+# Mirrors of the constants in GestureRecogniser/src/gesture_detector.hpp
+DETECTION_BUFFER_LENGTH = 10
+DETECTION_WINDOW_LENGTH = 5
+DETECTION_THRESHOLD_COEFF = 0.85
+THRESHOLD_ADJ_BUFFER_LENGTH = 100
+PRE_TRIGGER_LENGTH = DETECTION_BUFFER_LENGTH
+DETECTION_END_WINDOW_LENGTH = 10
+DETECTION_END_THRESHOLD_COEFF = 1.1
+MIN_CAPTURE_LENGTH = 30
+IDLE_DECIMATION = 5
+IDLE_CHANGE_THRESHOLD = 15
+IDLE_ARM_MARGIN = 1.1
+IDLE_HOLD_SAMPLES = 100
+
+class TFLiteModel:
+    """
+    Small wrapper around the TFLite interpreter that takes care of (de)quantization of the input and output tensors.
+    """
+
+    def __init__(self, model_path: str = "final_converted_model.tflite"):
+        self.interpreter = tf.lite.Interpreter(model_path=model_path)
+        self.interpreter.allocate_tensors()
+
+        self.input_details = self.interpreter.get_input_details()[0]
+        self.output_details = self.interpreter.get_output_details()[0]
+
+    def predict(self, sample: np.ndarray) -> np.ndarray:
+        """
+        Runs the model on a single pre-processed sample.
+
+        Args:
+            sample (np.ndarray): Pre-processed sample with shape INPUT_SHAPE.
+
+        Returns:
+            np.ndarray: The class scores.
+        """
+        sample = np.expand_dims(sample, axis=0)
+
+        if self.input_details['dtype'] != np.float32:
+            scale, zero_point = self.input_details['quantization']
+            sample = np.round(sample / scale + zero_point)
+
+        self.interpreter.set_tensor(self.input_details['index'], sample.astype(self.input_details['dtype']))
+        self.interpreter.invoke()
+
+        output = self.interpreter.get_tensor(self.output_details['index'])[0]
+
+        if self.output_details['dtype'] != np.float32:
+            scale, zero_point = self.output_details['quantization']
+            output = (output.astype(np.float32) - zero_point) * scale
+
+        return output
+
+    def time_invoke(self, repetitions: int = 100) -> float:
+        """
+        Measures the average time of a single Invoke() call on the host.
+
+        Returns:
+            float: Average invoke time in microseconds.
+        """
+        start = time.perf_counter()
+        for _ in range(repetitions):
+            self.interpreter.invoke()
+        return (time.perf_counter() - start) / repetitions * 1e6
+
+def load_replay_data(excluded_candidates: list = []) -> tuple:
+    """
+    Loads the raw (not pre-processed) recorded gestures of all candidates.
+
+    Returns:
+        tuple: A list of raw samples with shape (NUM_DATAPOINTS, 3) and a numpy array of integer labels.
+    """
+    all_data = data_loading.load_gestures_grouped_per_candidate(use_left_hand=True, use_right_hand=True, split_candidate_per_hand=True)
+
+    samples = []
+    labels = []
+    for candidate in all_data:
+        if candidate in excluded_candidates:
+            continue
+
+        for gesture in all_data[candidate]:
+            for sample in all_data[candidate][gesture]:
+                samples.append(np.array(sample, dtype=np.float32))
+                labels.append(gesture)
+
+    return samples, data_loading.map_labels_to_integers(labels)
+
+def model_input(raw_sample: np.ndarray) -> np.ndarray:
+    """
+    Pre-processes a raw sample and reshapes it to the model input shape, like ModelWrapper::infer does.
+    """
+    sample = data_processing.preprocess_data(np.array(raw_sample, dtype=np.float32))
+    return np.reshape(sample, INPUT_SHAPE)
+
+def pad_partial_window(raw_sample: np.ndarray, length: int, mode: str = "edge") -> np.ndarray:
+    """
+    Keeps the first length samples of a capture and pads it back to NUM_DATAPOINTS samples.
+
+    Args:
+        raw_sample (np.ndarray): Raw capture with shape (NUM_DATAPOINTS, 3).
+        length (int): Number of samples that have been captured.
+        mode (str): "edge" repeats the last captured sample (as the firmware does), "zero" pads with zeros.
+    """
+    partial = raw_sample[:length]
+    return np.pad(partial, ((0, NUM_DATAPOINTS - length), (0, 0)), mode="edge" if mode == "edge" else "constant")
+
+def confidence_margin(scores: np.ndarray) -> float:
+    """
+    Difference between the highest and second highest class score, like ModelWrapper::getConfidenceMargin.
+    """
+    top_two = np.sort(scores)[-2:]
+    return top_two[1] - top_two[0]
+
+def detection_thresholds(adjustment_buffer: np.ndarray) -> np.ndarray:
+    """
+    Start thresholds like GestureDetector::recalibrateThresholds: the median of the last THRESHOLD_ADJ_BUFFER_LENGTH
+    samples of every sensor times DETECTION_THRESHOLD_COEFF in single precision, truncated to an integer.
+    QuickMedian selects the element at index length / 2, the upper median of an even length.
+    """
+    ordered = np.sort(np.round(adjustment_buffer).astype(np.uint16), axis=0)
+    median = ordered[len(ordered) // 2]
+    return (median.astype(np.float32) * np.float32(DETECTION_THRESHOLD_COEFF)).astype(np.uint16)
+
+def end_thresholds(thresholds: np.ndarray) -> np.ndarray:
+    """
+    End thresholds like EdgeDetector::detectEdgeEnd: the start threshold times DETECTION_END_THRESHOLD_COEFF in single
+    precision, truncated to an integer.
+    """
+    return (np.asarray(thresholds).astype(np.float32) * np.float32(DETECTION_END_THRESHOLD_COEFF)).astype(np.uint16)
\ No newline at end of file
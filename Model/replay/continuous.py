@@ -0,0 +1,43 @@
+# Continuous inference: a window slides over the samples and is classified every hop (ContinuousDetector).
+
+import time
+
+import numpy as np
+
+from replay.common import READ_PERIOD_MS, TFLiteModel, model_input
+
+def benchmark_continuous_occupancy(model: TFLiteModel, samples: list, hop_sizes: tuple = (1, 2, 5, 10, 20, 25, 50, 100),
+                                   device_inference_us: float = None, repetitions: int = 100) -> list:
+    """
+    Reports the CPU occupancy of the continuous inference mode for a range of hop sizes.
+    The cost of one window is measured on the host (pre-processing plus invoke), unless the
+    inference time printed by the microcontroller ("Pre-processing done in" + "Inference finished in") is given.
+
+    Returns:
+        list: A dictionary per hop size with the window cost in us, the occupancy and the windows classified per second.
+    """
+
+    if device_inference_us is None:
+        start = time.perf_counter()
+        for i in range(repetitions):
+            model.predict(model_input(samples[i % len(samples)]))
+        window_cost_us = (time.perf_counter() - start) / repetitions * 1e6
+    else:
+        window_cost_us = device_inference_us
+
+    results = []
+    for hop in hop_sizes:
+        hop_period_us = hop * READ_PERIOD_MS * 1000
+        results.append({
+            'hop': hop,
+            'window_cost_us': window_cost_us,
+            'occupancy': window_cost_us / hop_period_us,
+            'windows_per_second': 1e6 / hop_period_us,
+        })
+
+    return results
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Continuous inference CPU occupancy per hop size (host timing):")
+    for result in benchmark_continuous_occupancy(model, samples):
+        print(f"  hop {result['hop']}: {result['occupancy'] * 100:.2f}% ({result['window_cost_us']:.0f} us per window)")
\ No newline at end of file
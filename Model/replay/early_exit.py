@@ -0,0 +1,91 @@
+# Early exit model: a first stage with its own classifier head, the second stage only runs when it is not confident
+# (ModelWrapper::inferEarlyExit).
+
+import time
+
+import numpy as np
+import tensorflow as tf
+
+import data_loading
+
+from replay.common import TFLiteModel, model_input
+
+def benchmark_early_exit(samples: list, labels: np.ndarray, thresholds: tuple = (0.7, 0.8, 0.9, 0.95, 0.99)) -> dict:
+    """
+    Reports the stage split of the early exit model and the latency and accuracy per exit, like ModelWrapper::inferEarlyExit.
+    Expects the TFLite files written by export_early_exit_model.
+    """
+    stage_1 = tf.lite.Interpreter(model_path="early_exit_stage_1.tflite")
+    stage_2 = tf.lite.Interpreter(model_path="early_exit_stage_2.tflite")
+    stage_1.allocate_tensors()
+    stage_2.allocate_tensors()
+
+    # The first stage has two outputs, the exit head scores are the one with a value per gesture
+    stage_1_outputs = stage_1.get_output_details()
+    exit_index = next(i for i, details in enumerate(stage_1_outputs) if details['shape'][-1] == len(data_loading.GestureNames)
+                      and len(details['shape']) == 2)
+
+    exit_1_scores = []
+    exit_2_scores = []
+    stage_1_time = 0
+    stage_2_time = 0
+    for sample in samples:
+        stage_1.set_tensor(stage_1.get_input_details()[0]['index'], np.expand_dims(model_input(sample), axis=0).astype(np.float32))
+
+        start = time.perf_counter()
+        stage_1.invoke()
+        stage_1_time += time.perf_counter() - start
+
+        exit_1_scores.append(stage_1.get_tensor(stage_1_outputs[exit_index]['index'])[0])
+        features = stage_1.get_tensor(stage_1_outputs[1 - exit_index]['index'])
+
+        stage_2.set_tensor(stage_2.get_input_details()[0]['index'], features)
+
+        start = time.perf_counter()
+        stage_2.invoke()
+        stage_2_time += time.perf_counter() - start
+
+        exit_2_scores.append(stage_2.get_tensor(stage_2.get_output_details()[0]['index'])[0])
+
+    stage_1_us = stage_1_time / len(samples) * 1e6
+    stage_2_us = stage_2_time / len(samples) * 1e6
+
+    exit_1_predictions = np.argmax(exit_1_scores, axis=1)
+    exit_2_predictions = np.argmax(exit_2_scores, axis=1)
+    exit_1_confidence = np.max(exit_1_scores, axis=1)
+
+    per_threshold = []
+    for threshold in thresholds:
+        early = exit_1_confidence >= threshold
+        predictions = np.where(early, exit_1_predictions, exit_2_predictions)
+        per_threshold.append({
+            'threshold': threshold,
+            'accuracy': np.mean(predictions == labels),
+            'exit_1_fraction': np.mean(early),
+            'exit_1_accuracy': np.mean(exit_1_predictions[early] == labels[early]) if np.any(early) else float('nan'),
+            'mean_us': stage_1_us + (1 - np.mean(early)) * stage_2_us,
+        })
+
+    # How often each gesture leaves at the first exit, for the highest threshold
+    gesture_names = [gesture.value for gesture in data_loading.GestureNames]
+    early = exit_1_confidence >= thresholds[-1]
+    exit_1_per_gesture = {name: np.mean(early[labels == i]) for i, name in enumerate(gesture_names) if np.any(labels == i)}
+
+    return {
+        'stage_1_us': stage_1_us,
+        'stage_2_us': stage_2_us,
+        'stage_1_fraction': stage_1_us / (stage_1_us + stage_2_us),
+        'exit_1_accuracy': np.mean(exit_1_predictions == labels),
+        'exit_2_accuracy': np.mean(exit_2_predictions == labels),
+        'per_threshold': per_threshold,
+        'exit_1_per_gesture': exit_1_per_gesture,
+    }
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Early exit model:")
+    result = benchmark_early_exit(samples, labels)
+    print(f"  stage 1 {result['stage_1_us']:.0f} us ({result['stage_1_fraction'] * 100:.0f}%), stage 2 {result['stage_2_us']:.0f} us, "
+          f"accuracy at exit 1 {result['exit_1_accuracy']:.4f}, at exit 2 {result['exit_2_accuracy']:.4f} (host)")
+    for threshold in result['per_threshold']:
+        print(f"  threshold {threshold['threshold']}: accuracy {threshold['accuracy']:.4f}, "
+              f"exit 1 taken {threshold['exit_1_fraction'] * 100:.1f}%, mean {threshold['mean_us']:.0f} us")
\ No newline at end of file
@@ -0,0 +1,117 @@
+# Early prediction: commits to a prediction on a partial capture when the model is confident enough
+# (GestureDetector::tryEarlyCommit).
+
+import numpy as np
+
+from replay.common import NUM_DATAPOINTS, READ_PERIOD_MS, TFLiteModel, confidence_margin, model_input, pad_partial_window
+
+# Mirror of the constant in GestureRecogniser/src/global_constants.hpp
+EARLY_COMMIT_MARGIN = 0.6
+
+def missed_samples(inference_ms: float) -> int:
+    """
+    Number of ticks the capture of GestureDetector::detectGesture misses while a provisional inference of inference_ms runs.
+    """
+    return max(0, int((inference_ms - READ_PERIOD_MS) // READ_PERIOD_MS))
+
+def fill_missed_samples(capture: np.ndarray, length: int, missed: int) -> np.ndarray:
+    """
+    Replaces the missed samples after the first length samples of a capture by linear interpolation between the last
+    sample before them and the sample that is read after the inference, with the integer arithmetic of the firmware.
+    """
+    index = min(length + missed, len(capture) - 1)
+    if index <= length:
+        return capture
+
+    capture = np.array(capture, dtype=np.float32)
+    previous = capture[length - 1].astype(np.int64)
+    difference = capture[index].astype(np.int64) - previous
+    for j in range(length, index):
+        # Integer division in C++ truncates towards zero
+        capture[j] = previous + np.trunc(difference * (j - length + 1) / (index - length + 1))
+    return capture
+
+def firmware_scores(model: TFLiteModel, sample: np.ndarray, checkpoints: tuple, pad_mode: str, inference_ms: float) -> tuple:
+    """
+    The scores at every checkpoint and of the full capture, for a capture that misses the ticks during every provisional
+    inference. The provisional inferences run when the captured length passes a checkpoint, so after a gap they can run
+    on a few samples more than the checkpoint.
+
+    Returns:
+        The scores and the captured length of every inference.
+    """
+    missed = missed_samples(inference_ms)
+    capture = np.asarray(sample, dtype=np.float32)
+
+    scores = []
+    lengths = []
+    captured = 0
+    for checkpoint in checkpoints:
+        length = max(checkpoint, captured)
+        if length >= NUM_DATAPOINTS:
+            break
+
+        scores.append(model.predict(model_input(pad_partial_window(capture, length, pad_mode))))
+        lengths.append(length)
+
+        capture = fill_missed_samples(capture, length, missed)
+        captured = length + missed + 1
+
+    scores.append(model.predict(model_input(capture)))
+    lengths.append(NUM_DATAPOINTS)
+    return scores, lengths
+
+def evaluate_early_prediction(model: TFLiteModel, samples: list, labels: np.ndarray, checkpoints: tuple = (40, 60, 80),
+                              margins: tuple = (0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9), pad_mode: str = "edge",
+                              inference_ms: float = 0) -> list:
+    """
+    Replays all samples through the early prediction logic of GestureDetector::tryEarlyCommit for a range of commit margins.
+    Every provisional inference takes inference_ms, the samples the capture misses meanwhile are interpolated like the
+    firmware does. Use the inference time printed by the microcontroller ("Inference finished in").
+
+    Returns:
+        list: A dictionary per margin with the accuracy, the mean capture latency in ms and the fraction of early commits.
+    """
+
+    # Predictions only depend on the checkpoint and not on the margin, so compute them once
+    replayed = [firmware_scores(model, sample, checkpoints, pad_mode, inference_ms) for sample in samples]
+
+    results = []
+    for margin in (None,) + tuple(margins):
+        correct = 0
+        latency = 0
+        early = 0
+        for (sample_scores, lengths), label in zip(replayed, labels):
+            committed = len(lengths) - 1
+            if margin is not None:
+                for i in range(len(lengths) - 1):
+                    if confidence_margin(sample_scores[i]) >= margin:
+                        committed = i
+                        early += 1
+                        break
+
+            correct += int(np.argmax(sample_scores[committed]) == label)
+            # The capture keeps its time grid, so the missed samples don't add latency
+            latency += lengths[committed] * READ_PERIOD_MS
+
+        results.append({
+            'margin': margin,
+            'inference_ms': inference_ms,
+            'accuracy': correct / len(samples),
+            'mean_latency_ms': latency / len(samples),
+            'early_fraction': early / len(samples),
+        })
+
+    return results
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Early prediction (margin None is the full capture baseline):")
+    for result in evaluate_early_prediction(model, samples, labels):
+        print(f"  margin {result['margin']}: accuracy {result['accuracy']:.4f}, "
+              f"mean capture latency {result['mean_latency_ms']:.1f} ms, committed early {result['early_fraction'] * 100:.1f}%")
+
+    print(f"Early prediction at margin {EARLY_COMMIT_MARGIN} with the samples missed during the provisional inferences:")
+    for inference_ms in (25, 50, 100):
+        baseline, result = evaluate_early_prediction(model, samples, labels, margins=(EARLY_COMMIT_MARGIN,), inference_ms=inference_ms)
+        print(f"  {inference_ms} ms per inference ({missed_samples(inference_ms)} samples missed): accuracy {result['accuracy']:.4f}, "
+              f"{baseline['accuracy']:.4f} without committing early, mean capture latency {result['mean_latency_ms']:.1f} ms")
\ No newline at end of file
@@ -0,0 +1,143 @@
+# The low pass filter designed at runtime (Butterworth) and the biquad engine that runs it (Biquad).
+
+import time
+
+import numpy as np
+
+import data_processing
+
+from replay.common import LOW_PASS_CUTOFF, READ_PERIOD_MS, TFLiteModel
+
+def butterworth_coefficients_float32(sample_rate: float, cutoff: float) -> tuple:
+    """
+    Butterworth::LowPass of the firmware, which designs the filter in single precision.
+    """
+    f = np.float32
+    wc = f(2) * f(np.pi) * f(cutoff)
+    k = f(2) * f(sample_rate)
+    damping = f(np.sqrt(2)) * wc * k
+    norm = f(1) / (k * k + damping + wc * wc)
+
+    b0 = wc * wc * norm
+    return [f(2) * (k * k - wc * wc) * norm, -(k * k - damping + wc * wc) * norm], [b0, f(2) * b0, b0]
+
+def verify_filter_design(samples: list, configurations: tuple = ((100, 25), (100, 10), (50, 12.5), (50, 10), (20, 5))) -> list:
+    """
+    Compares the low pass filter that the firmware designs at runtime with the reference design in data_processing,
+    on the coefficients and on the pre-processed recorded gestures. At the default configuration the design is also
+    compared with the coefficients that were hard-coded before, on which the model was trained.
+
+    Returns:
+        For every sample rate and cutoff the largest coefficient and output deviation, and the host design time.
+    """
+    legacy = np.array([0.28094574, -0.18556054, 0.2261537, 0.4523074, 0.2261537])
+
+    results = []
+    for sample_rate, cutoff in configurations:
+        a, b = data_processing.butterworth_coefficients(sample_rate, cutoff)
+
+        start = time.perf_counter()
+        a32, b32 = butterworth_coefficients_float32(sample_rate, cutoff)
+        design_us = (time.perf_counter() - start) * 1e6
+
+        reference = np.array(a + b)
+        device = np.array(a32 + b32, dtype=np.float64)
+
+        output_deviation = 0
+        for sample in samples:
+            signal = data_processing.remove_mean_divide_std(data_processing.rescale_signal(np.asarray(sample, dtype=np.float64)))
+            for column in signal.T:
+                expected = data_processing.butterworth_filter(column.astype(np.float64), sample_rate, cutoff)
+                actual = column.astype(np.float32)
+                for i in range(2, len(actual)):
+                    actual[i] = a32[0] * actual[i-1] + a32[1] * actual[i-2] + b32[0] * actual[i] + b32[1] * actual[i-1] + b32[2] * actual[i-2]
+                output_deviation = max(output_deviation, np.max(np.abs(actual - expected)))
+
+        results.append({
+            'sample_rate': sample_rate,
+            'cutoff': cutoff,
+            'coefficient_deviation': np.max(np.abs(device - reference)),
+            'legacy_deviation': np.max(np.abs(reference - legacy)) if (sample_rate, cutoff) == (1000 / READ_PERIOD_MS, LOW_PASS_CUTOFF) else None,
+            'output_deviation': output_deviation,
+            'design_us': design_us,
+        })
+
+    return results
+
+def biquad_cascade(signal: np.ndarray, sections: list, q15: bool = False) -> np.ndarray:
+    """
+    Biquad<T, N> of the firmware, in transposed direct form II from a zero state. Sections are (a, b) pairs in the
+    convention of data_processing.butterworth_filter. With q15 the signal is in [-1, 1) and is filtered like the int16_t
+    instantiation: Q2.14 coefficients, rounded and saturated Q15 outputs.
+    """
+    signal = np.asarray(signal, dtype=np.float64)
+    if q15:
+        signal = np.clip(np.round(signal * 32768), -32768, 32767).astype(np.int64)
+
+    for a, b in sections:
+        coefficients = [b[0], b[1], b[2], a[0], a[1]]
+        if q15:
+            coefficients = [int(np.round(c * (1 << 14))) for c in coefficients]
+        b0, b1, b2, a1, a2 = coefficients
+
+        output = np.zeros_like(signal)
+        s1 = s2 = 0
+        for n, x in enumerate(signal):
+            acc = b0 * x + s1
+            y = min(max((acc + (1 << 13)) >> 14, -32768), 32767) if q15 else acc
+            s1 = b1 * x + a1 * y + s2
+            s2 = b2 * x + a2 * y
+            output[n] = y
+        signal = output
+
+    return signal / 32768 if q15 else signal
+
+def verify_biquad_engine(samples: list) -> dict:
+    """
+    Checks that the biquad section the Preprocessor runs (the in place recurrence the model is trained on, written as
+    an all-pole section that starts after the first two samples) gives the same output as butterworth_filter, and how
+    far the Q15 instantiation is from float for a 4th order cascade.
+
+    Returns:
+        The largest deviation of the preprocessor section and of the Q15 cascade over the recorded gestures.
+    """
+    a, b = data_processing.butterworth_coefficients(1000 / READ_PERIOD_MS, LOW_PASS_CUTOFF)
+    all_pole = ([a[0] + b[1], a[1] + b[2]], [b[0], 0, 0])
+    cascade = [data_processing.butterworth_coefficients(1000 / READ_PERIOD_MS, 10)] * 2
+
+    preprocessor_deviation = 0
+    q15_deviation = 0
+    for sample in samples:
+        signal = data_processing.remove_mean_divide_std(data_processing.rescale_signal(np.asarray(sample, dtype=np.float64)))
+        for column in signal.T:
+            expected = data_processing.butterworth_filter(column.astype(np.float64))
+
+            # The state continues from the first two samples, which are passed through
+            first = column.astype(np.float64)
+            actual = first.copy()
+            y1, y0 = first[1], first[0]
+            for n in range(2, len(actual)):
+                actual[n] = all_pole[1][0] * first[n] + all_pole[0][0] * y1 + all_pole[0][1] * y0
+                y0, y1 = y1, actual[n]
+            preprocessor_deviation = max(preprocessor_deviation, np.max(np.abs(actual - expected)))
+
+            # Scaled into the range of Q15 with some headroom
+            scaled = column / (2 * np.max(np.abs(column)))
+            q15_deviation = max(q15_deviation, np.max(np.abs(biquad_cascade(scaled, cascade, q15=True) - biquad_cascade(scaled, cascade))))
+
+    return {
+        'preprocessor_deviation': preprocessor_deviation,
+        'q15_deviation': q15_deviation,
+    }
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Low pass filter designed at runtime, largest deviation from the reference design:")
+    for result in verify_filter_design(samples):
+        legacy = f", {result['legacy_deviation']:.1e} from the hard-coded coefficients" if result['legacy_deviation'] is not None else ""
+        print(f"  {result['sample_rate']} Hz, cutoff {result['cutoff']} Hz: coefficients {result['coefficient_deviation']:.1e}{legacy}, "
+              f"pre-processed gestures {result['output_deviation']:.1e} (design {result['design_us']:.1f} us on the host)")
+
+    print("Biquad engine:")
+    biquad = verify_biquad_engine(samples)
+    print(f"  preprocessor section {biquad['preprocessor_deviation']:.1e} from butterworth_filter, "
+          f"Q15 4th order cascade {biquad['q15_deviation']:.1e} from float (full scale 1)")
\ No newline at end of file
@@ -0,0 +1,114 @@
+# Gesture detection across a gain switch of the light sensors (GestureDetector::rescaleForGain).
+
+import numpy as np
+
+from replay.common import (ADC_MAX_READING, DETECTION_BUFFER_LENGTH, DETECTION_THRESHOLD_COEFF, DETECTION_WINDOW_LENGTH,
+                           THRESHOLD_ADJ_BUFFER_LENGTH, TFLiteModel)
+
+def first_edge_start(stream: np.ndarray, thresholds: np.ndarray, armed_from: int = 0) -> int:
+    """
+    Returns the first sample index at which the edge start of GestureDetector fires: the last DETECTION_WINDOW_LENGTH
+    samples of one of the sensors are below its threshold. Returns -1 when it never fires.
+
+    Args:
+        stream: samples of shape (time, sensors)
+        thresholds: the threshold of every sensor at every sample, of shape (time, sensors)
+        armed_from: the first sample at which the detection window is full
+    """
+    below = stream < thresholds
+    for t in range(max(armed_from, DETECTION_WINDOW_LENGTH - 1), len(stream)):
+        if np.any(np.all(below[t - DETECTION_WINDOW_LENGTH + 1:t + 1], axis=0)):
+            return t
+    return -1
+
+def simulate_gain_change_detection(samples: list, ratios: tuple = (0.5, 2.0), gap: int = 3, gain_error: float = 0.1,
+                                   seed: int = 1337) -> dict:
+    """
+    Replays every recorded gesture shortly after the light sensors switched gain, and compares the ways the gesture
+    detector can handle the switch:
+    stale: thresholds and buffers are left as they are,
+    restart: thresholds are scaled and the detection window is collected again (blind for DETECTION_BUFFER_LENGTH samples),
+    rescale: thresholds and buffered samples are scaled with the gain model, detection continues.
+    The gain model is off by up to gain_error, like an uncalibrated resistor tolerance.
+
+    Args:
+        samples: recorded gestures, at the gain after the switch
+        ratios: gain ratios new / old to simulate
+        gap: number of ambient samples between the switch and the start of the gesture
+        gain_error: maximum relative error of the gain model
+
+    Returns:
+        For every ratio and strategy the fraction of gestures that were detected, that triggered falsely before
+        the gesture, and the mean detection delay in samples compared to detection without a gain change.
+    """
+    rng = np.random.default_rng(seed)
+    strategies = ('stale', 'restart', 'rescale')
+    results = {}
+
+    for ratio in ratios:
+        counts = {strategy: {'detected': 0, 'false': 0, 'delays': []} for strategy in strategies}
+
+        for sample in samples:
+            sample = np.asarray(sample, dtype=np.float32)
+            # The recordings start at the edge trigger, so the ambient level is taken from the brightest samples
+            baseline = np.percentile(sample, 90, axis=0)
+            true_ratio = ratio * (1 + rng.uniform(-gain_error, gain_error))
+
+            # Ambient light before the switch, then the gesture a few samples after it
+            before = baseline / true_ratio + rng.normal(0, 2, size=(THRESHOLD_ADJ_BUFFER_LENGTH, sample.shape[1]))
+            after = baseline + rng.normal(0, 2, size=(gap, sample.shape[1]))
+            stream = np.clip(np.concatenate([before, after, sample]), 0, ADC_MAX_READING)
+            switch = len(before)
+            start = switch + gap
+
+            old_threshold = np.median(stream[:switch], axis=0) * DETECTION_THRESHOLD_COEFF
+            # Where the edge start fires when the gain was never changed, relative to the start of the gesture
+            unchanged = stream[switch:]
+            reference = first_edge_start(unchanged, np.broadcast_to(baseline * DETECTION_THRESHOLD_COEFF, unchanged.shape))
+            if reference >= 0:
+                reference -= gap
+
+            for strategy in strategies:
+                # Before the switch the detector ran at the old gain, only what happens after it is compared
+                thresholds = np.broadcast_to(old_threshold, stream.shape).copy()
+                detection_stream = stream.copy()
+                armed_from = switch
+
+                if strategy == 'restart':
+                    thresholds[switch:] = np.clip(old_threshold * ratio, 0, ADC_MAX_READING)
+                    armed_from = switch + DETECTION_BUFFER_LENGTH - 1
+                elif strategy == 'rescale':
+                    # The samples in the detection window from before the switch are brought to the new gain
+                    thresholds[:] = np.clip(old_threshold * ratio, 0, ADC_MAX_READING)
+                    detection_stream[:switch] = np.clip(np.round(stream[:switch] * ratio), 0, ADC_MAX_READING)
+
+                fired = first_edge_start(detection_stream, thresholds, armed_from)
+                if fired < 0:
+                    continue
+
+                # Firing before the edge that is found without a gain change is a false trigger
+                if fired < start + max(reference, 0):
+                    counts[strategy]['false'] += 1
+                    continue
+
+                counts[strategy]['detected'] += 1
+                if reference >= 0:
+                    counts[strategy]['delays'].append(fired - start - reference)
+
+        results[ratio] = {
+            strategy: {
+                'detected': counts[strategy]['detected'] / len(samples),
+                'false_triggers': counts[strategy]['false'] / len(samples),
+                'mean_delay': np.mean(counts[strategy]['delays']) if counts[strategy]['delays'] else float('nan'),
+            }
+            for strategy in strategies
+        }
+
+    return results
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Gesture detection right after a gain change:")
+    for ratio, per_strategy in simulate_gain_change_detection(samples).items():
+        for strategy, result in per_strategy.items():
+            print(f"  ratio {ratio} {strategy}: detected {result['detected'] * 100:.1f}%, "
+                  f"false triggers {result['false_triggers'] * 100:.1f}%, mean delay {result['mean_delay']:.1f} samples")
\ No newline at end of file
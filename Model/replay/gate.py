@@ -0,0 +1,156 @@
+# Gesture gate: cheap checks on the raw capture that reject false triggers before the model runs (GestureGate).
+
+import numpy as np
+
+from replay.common import NUM_DATAPOINTS, TFLiteModel, confidence_margin, model_input, pad_partial_window
+from replay.continuous import benchmark_continuous_occupancy
+from replay.early_prediction import EARLY_COMMIT_MARGIN
+
+GATE_SATURATION_LEVEL = 1020
+GATE_MAX_SATURATED_FRACTION = 0.25
+GATE_MIN_RELATIVE_ENERGY = 0.03
+GATE_MIN_RELATIVE_RANGE = 0.1
+GATE_MAX_RELATIVE_STEP = 0.6
+GATE_LEVEL_LENGTH = 5
+
+def gesture_gate(raw_sample: np.ndarray) -> str:
+    """
+    Same checks as GestureGate::check on a raw capture with shape (length, 3).
+
+    Returns:
+        str: "accepted" or the reason the capture was rejected.
+    """
+    length = raw_sample.shape[0]
+
+    saturated = np.sum(raw_sample >= GATE_SATURATION_LEVEL, axis=0)
+    if np.any(saturated > GATE_MAX_SATURATED_FRACTION * length):
+        return "saturated"
+
+    mean = np.mean(raw_sample, axis=0)
+    std = np.std(raw_sample, axis=0)
+    if not np.any((mean > 0) & (std >= GATE_MIN_RELATIVE_ENERGY * mean)):
+        return "low energy"
+
+    maximum = np.max(raw_sample, axis=0)
+    signal_range = maximum - np.min(raw_sample, axis=0)
+    if not np.any((maximum > 0) & (signal_range >= GATE_MIN_RELATIVE_RANGE * maximum)):
+        return "flat"
+
+    step = np.abs(np.mean(raw_sample[:GATE_LEVEL_LENGTH], axis=0) - np.mean(raw_sample[-GATE_LEVEL_LENGTH:], axis=0))
+    if np.all((signal_range > 0) & (step > GATE_MAX_RELATIVE_STEP * signal_range)):
+        return "ambient light change"
+
+    return "accepted"
+
+def synthetic_false_triggers(samples: list, seed: int = 1337) -> list:
+    """
+    Creates captures without a gesture that would still pass the edge trigger, based on the ambient level of recorded gestures:
+    a lasting drop in ambient light, a slow dimming ramp, a noisy constant level and a clipped signal.
+    """
+    rng = np.random.default_rng(seed)
+
+    captures = []
+    for sample in samples:
+        baseline = np.median(sample[:10], axis=0)
+        noise = rng.normal(0, 2, size=sample.shape)
+        t = np.arange(NUM_DATAPOINTS)[:, None]
+
+        step_at = rng.integers(0, 10)
+        step = np.where(t < step_at, baseline, baseline * rng.uniform(0.3, 0.8))
+        ramp = baseline * (1 - rng.uniform(0.2, 0.5) * t / NUM_DATAPOINTS)
+        constant = np.broadcast_to(baseline, sample.shape)
+        clipped = np.full(sample.shape, 1023.0)
+
+        for capture in (step, ramp, constant, clipped):
+            captures.append(np.clip(capture + noise, 0, 1023).astype(np.float32))
+
+    return captures
+
+def evaluate_gesture_gate(model: TFLiteModel, samples: list, labels: np.ndarray) -> dict:
+    """
+    Measures the false reject rate of the gate on the recorded gestures, the false accept rate on synthetic
+    false triggers, and the inference time that is no longer wasted on the rejected false triggers.
+    """
+    gesture_results = [gesture_gate(sample) for sample in samples]
+    false_triggers = synthetic_false_triggers(samples)
+    false_trigger_results = [gesture_gate(capture) for capture in false_triggers]
+
+    # Accuracy of the cascade: a rejected gesture counts as a wrong prediction
+    correct = 0
+    for sample, label, result in zip(samples, labels, gesture_results):
+        if result == "accepted" and np.argmax(model.predict(model_input(sample))) == label:
+            correct += 1
+
+    window_cost_us = benchmark_continuous_occupancy(model, samples, hop_sizes=(1,))[0]['window_cost_us']
+    rejected_false_triggers = sum(result != "accepted" for result in false_trigger_results)
+
+    reasons = {}
+    for result in gesture_results + false_trigger_results:
+        reasons[result] = reasons.get(result, 0) + 1
+
+    return {
+        'false_reject_rate': sum(result != "accepted" for result in gesture_results) / len(samples),
+        'false_accept_rate': 1 - rejected_false_triggers / len(false_triggers),
+        'cascade_accuracy': correct / len(samples),
+        'saved_inference_ms': rejected_false_triggers * window_cost_us / 1000,
+        'false_triggers': len(false_triggers),
+        'reasons': reasons,
+    }
+
+def gated_early_commit(model: TFLiteModel, capture: np.ndarray, checkpoints: tuple, margin: float, gate_partial: bool = True):
+    """
+    The prediction the firmware reports for a capture with early prediction and the gate: at every checkpoint the
+    partial capture is gated (earlyCommitCallback) and committed when the model is confident enough, otherwise the full
+    capture is gated (gestureDetectedCallback). With gate_partial False the partial captures skip the gate.
+
+    Returns:
+        The predicted class, or None when no prediction is reported, and whether it was committed early.
+    """
+    for checkpoint in checkpoints:
+        if gate_partial and gesture_gate(capture[:checkpoint]) != "accepted":
+            continue
+
+        scores = model.predict(model_input(pad_partial_window(capture, checkpoint)))
+        if confidence_margin(scores) >= margin:
+            return int(np.argmax(scores)), True
+
+    if gesture_gate(capture) != "accepted":
+        return None, False
+    return int(np.argmax(model.predict(model_input(capture)))), False
+
+def evaluate_gate_with_early_commit(model: TFLiteModel, samples: list, labels: np.ndarray, checkpoints: tuple = (40, 60, 80),
+                                    margin: float = EARLY_COMMIT_MARGIN) -> dict:
+    """
+    Measures the false reject and false accept rate of the gate like evaluate_gesture_gate, when predictions can be
+    committed early on partial captures. A false trigger counts as accepted when any prediction is reported for it.
+
+    Returns:
+        The rates and accuracy with the partial captures gated, and the false accept rate when they are not.
+    """
+    false_triggers = synthetic_false_triggers(samples)
+
+    gestures = [gated_early_commit(model, sample, checkpoints, margin) for sample in samples]
+    triggers = [gated_early_commit(model, capture, checkpoints, margin) for capture in false_triggers]
+    ungated = [gated_early_commit(model, capture, checkpoints, margin, gate_partial=False) for capture in false_triggers]
+
+    return {
+        'false_reject_rate': sum(prediction is None for prediction, _ in gestures) / len(samples),
+        'false_accept_rate': sum(prediction is not None for prediction, _ in triggers) / len(false_triggers),
+        'ungated_false_accept_rate': sum(prediction is not None for prediction, _ in ungated) / len(false_triggers),
+        'cascade_accuracy': sum(prediction == label for (prediction, _), label in zip(gestures, labels)) / len(samples),
+        'early_fraction': sum(early for _, early in gestures) / len(samples),
+    }
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Gesture gate:")
+    gate = evaluate_gesture_gate(model, samples, labels)
+    print(f"  false reject rate {gate['false_reject_rate'] * 100:.2f}%, false accept rate {gate['false_accept_rate'] * 100:.2f}%, "
+          f"accuracy with gate {gate['cascade_accuracy']:.4f}")
+    print(f"  {gate['saved_inference_ms']:.0f} ms of inference saved on {gate['false_triggers']} false triggers (host timing)")
+    print(f"  gate results: {gate['reasons']}")
+
+    print(f"Gesture gate with early prediction at margin {EARLY_COMMIT_MARGIN}:")
+    early = evaluate_gate_with_early_commit(model, samples, labels)
+    print(f"  false reject rate {early['false_reject_rate'] * 100:.2f}%, false accept rate {early['false_accept_rate'] * 100:.2f}% "
+          f"({early['ungated_false_accept_rate'] * 100:.2f}% without gating the partial captures), "
+          f"accuracy {early['cascade_accuracy']:.4f}, committed early {early['early_fraction'] * 100:.1f}%")
\ No newline at end of file
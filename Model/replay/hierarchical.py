@@ -0,0 +1,66 @@
+# Hierarchical classifier: a family model followed by a specialist per family (ModelWrapper::inferHierarchical).
+
+import time
+
+import numpy as np
+
+from replay.common import TFLiteModel, model_input
+
+def evaluate_hierarchical(model: TFLiteModel, samples: list, labels: np.ndarray, family_sizes: tuple = (4, 2, 2, 2),
+                          model_names: tuple = ("swipe", "circle", "tap", "zoom"), seed: int = 0) -> dict:
+    """
+    Compares the single model with the hierarchical classifier (ModelWrapper::inferHierarchical) on accuracy and
+    average host latency. Expects the TFLite files written by export_hierarchical_models.
+    Like the firmware, only one specialist is loaded at a time and it is reloaded when the family changes, so the
+    latency includes the reloads. The samples are replayed in a random order, as the recordings are grouped by gesture.
+    The arena usage is printed by the microcontroller at boot ("Used bytes family model").
+    """
+    family_model = TFLiteModel("family_model.tflite")
+    specialist_files = [f"{name}_model.tflite" for name in model_names]
+    offsets = np.cumsum((0,) + tuple(family_sizes))
+
+    single_correct = 0
+    hierarchical_correct = 0
+    single_time = 0
+    hierarchical_time = 0
+    reload_time = 0
+    reloads = 0
+    loaded_family = None
+    specialist = None
+    for index in np.random.default_rng(seed).permutation(len(samples)):
+        sample, label = samples[index], labels[index]
+        model_in = model_input(sample)
+
+        start = time.perf_counter()
+        single_correct += int(np.argmax(model.predict(model_in)) == label)
+        single_time += time.perf_counter() - start
+
+        start = time.perf_counter()
+        family = int(np.argmax(family_model.predict(model_in)))
+        if family != loaded_family:
+            reload_start = time.perf_counter()
+            specialist = TFLiteModel(specialist_files[family])
+            reload_time += time.perf_counter() - reload_start
+            loaded_family = family
+            reloads += 1
+        prediction = offsets[family] + int(np.argmax(specialist.predict(model_in)))
+        hierarchical_time += time.perf_counter() - start
+
+        hierarchical_correct += int(prediction == label)
+
+    return {
+        'single_accuracy': single_correct / len(samples),
+        'hierarchical_accuracy': hierarchical_correct / len(samples),
+        'single_us': single_time / len(samples) * 1e6,
+        'hierarchical_us': hierarchical_time / len(samples) * 1e6,
+        'reload_fraction': reloads / len(samples),
+        'reload_us': reload_time / max(reloads, 1) * 1e6,
+    }
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Hierarchical classifier:")
+    result = evaluate_hierarchical(model, samples, labels)
+    print(f"  accuracy {result['hierarchical_accuracy']:.4f} instead of {result['single_accuracy']:.4f}, "
+          f"{result['hierarchical_us']:.0f} us instead of {result['single_us']:.0f} us per inference (host)")
+    print(f"  specialist reloaded in {result['reload_fraction']:.1%} of inferences, "
+          f"{result['reload_us']:.0f} us per reload, included in the latency")
\ No newline at end of file
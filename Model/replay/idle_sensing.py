@@ -0,0 +1,167 @@
+# Idle sensing: the light sensors are read at a lower rate while nothing moves (IDLE_DECIMATION).
+
+import numpy as np
+
+from replay.common import (DETECTION_BUFFER_LENGTH, DETECTION_THRESHOLD_COEFF, DETECTION_WINDOW_LENGTH, IDLE_ARM_MARGIN,
+                           IDLE_CHANGE_THRESHOLD, IDLE_HOLD_SAMPLES, NUM_DATAPOINTS, READ_PERIOD_MS, TFLiteModel, model_input)
+
+def interpolate_history(history: np.ndarray, idle_entries: int, decimation: int) -> np.ndarray:
+    """
+    Turns the history into full rate samples like GestureDetector::interpolateHistory. The newest idle_entries entries
+    were taken every decimation ticks, the older ones every tick. Ticks older than the oldest entry repeat it.
+    """
+    size = len(history)
+    idle_entries = min(idle_entries, size)
+    if idle_entries == 0 or size < 2:
+        return history
+
+    def entry_age(j):
+        return j * decimation if j < idle_entries else idle_entries * decimation + (j - idle_entries)
+
+    # Integer division of the firmware, which truncates towards zero
+    def divide(a, b):
+        return int(np.sign(a)) * (abs(int(a)) // b)
+
+    result = np.empty_like(history)
+    j = 0
+    for age in range(size):
+        while j + 1 < size and entry_age(j + 1) <= age:
+            j += 1
+
+        newer = history[size - 1 - j].astype(int)
+        if j + 1 == size:
+            result[size - 1 - age] = newer
+            continue
+
+        difference = history[size - 2 - j].astype(int) - newer
+        span = entry_age(j + 1) - entry_age(j)
+        result[size - 1 - age] = [n + divide(d * (age - entry_age(j)), span) for n, d in zip(newer, difference)]
+    return result
+
+def replay_idle_sensing(stream: np.ndarray, thresholds: np.ndarray, decimation: int) -> tuple:
+    """
+    Runs the sampling of GestureDetector with idle sensing over a stream of full rate samples until the edge start fires.
+
+    Returns:
+        The tick at which the gesture was detected (-1 when it was not), the captured gesture and the number of sampled ticks.
+    """
+    window = []
+    previous = np.zeros(stream.shape[1])
+    idle = False
+    idle_ticks = 0
+    idle_rate_samples = 0
+    quiet = 0
+    sampled = 0
+
+    for t, sample in enumerate(stream):
+        if idle:
+            idle_ticks += 1
+            if idle_ticks < decimation:
+                continue
+        idle_ticks = 0
+        sampled += 1
+
+        window = (window + [sample])[-DETECTION_BUFFER_LENGTH:]
+
+        activity = np.any(np.abs(sample - previous) > IDLE_CHANGE_THRESHOLD) or np.any(sample < thresholds * IDLE_ARM_MARGIN)
+        previous = sample
+        if idle:
+            idle_rate_samples += 1
+        if idle and activity:
+            idle = False
+            quiet = 0
+            window = list(interpolate_history(np.array(window), idle_rate_samples, decimation))
+        elif not idle:
+            quiet = 0 if activity else quiet + 1
+            if quiet >= IDLE_HOLD_SAMPLES:
+                idle = True
+                idle_rate_samples = 0
+
+        if len(window) == DETECTION_BUFFER_LENGTH and np.any(np.all(np.array(window[-DETECTION_WINDOW_LENGTH:]) < thresholds, axis=0)):
+            capture = np.concatenate([np.array(window), stream[t + 1:t + 1 + NUM_DATAPOINTS - DETECTION_BUFFER_LENGTH]])
+            return t, capture, sampled
+
+    return -1, None, sampled
+
+def simulate_idle_sensing(model: TFLiteModel, samples: list, labels: np.ndarray, decimations: tuple = (1, 2, 5, 10),
+                          idle_length: int = 1000, seed: int = 1337) -> list:
+    """
+    Replays every recorded gesture after a period without motion, with idle sensing at several decimation factors.
+    A decimation of 1 is the full rate baseline. The gesture starts at a random phase of the idle sampling.
+
+    Args:
+        idle_length: number of full rate ticks without motion before the gesture
+
+    Returns:
+        For every decimation the fraction of ticks at which the ADC was read, the mean detection latency compared to
+        the full rate in ticks, the detection rate and the accuracy of the model on the captured gestures.
+        The pre-trigger samples of a capture right after idle sensing are interpolated, so the accuracy is also given for
+        the same captures with the full rate samples before the trigger, and the fraction of captures that differ.
+    """
+    rng = np.random.default_rng(seed)
+
+    # The same streams are replayed at every decimation
+    streams = []
+    for sample in samples:
+        sample = np.asarray(sample, dtype=np.float32)
+        baseline = np.percentile(sample, 90, axis=0)
+        length = idle_length + rng.integers(0, max(decimations))
+        ambient = baseline + rng.normal(0, 2, size=(length, sample.shape[1]))
+        after = np.broadcast_to(baseline, (NUM_DATAPOINTS, sample.shape[1]))
+        stream = np.clip(np.round(np.concatenate([ambient, sample, after])), 0, 1023)
+        streams.append((stream, baseline * DETECTION_THRESHOLD_COEFF))
+
+    references = [replay_idle_sensing(stream, thresholds, 1)[0] for stream, thresholds in streams]
+
+    results = []
+    for decimation in decimations:
+        sampled_ticks = 0
+        total_ticks = 0
+        latencies = []
+        correct = 0
+        correct_true_history = 0
+        interpolated = 0
+        detected = 0
+
+        for (stream, thresholds), reference, label in zip(streams, references, labels):
+            fired, capture, sampled = replay_idle_sensing(stream, thresholds, decimation)
+
+            total_ticks += (fired if fired >= 0 else len(stream) - 1) + 1
+            sampled_ticks += sampled
+            if fired < 0:
+                continue
+
+            detected += 1
+            if reference >= 0:
+                latencies.append(fired - reference)
+            if len(capture) < NUM_DATAPOINTS or fired + 1 < DETECTION_BUFFER_LENGTH:
+                continue
+
+            true_capture = stream[fired + 1 - DETECTION_BUFFER_LENGTH:fired + 1 + NUM_DATAPOINTS - DETECTION_BUFFER_LENGTH]
+            if np.argmax(model.predict(model_input(capture))) == label:
+                correct += 1
+            if not np.array_equal(capture, true_capture):
+                interpolated += 1
+                correct_true_history += int(np.argmax(model.predict(model_input(true_capture))) == label)
+            else:
+                correct_true_history += int(np.argmax(model.predict(model_input(capture))) == label)
+
+        results.append({
+            'decimation': decimation,
+            'adc_duty_cycle': sampled_ticks / total_ticks,
+            'mean_latency_ms': np.mean(latencies) * READ_PERIOD_MS if latencies else float('nan'),
+            'detected': detected / len(samples),
+            'accuracy': correct / len(samples),
+            'accuracy_true_history': correct_true_history / len(samples),
+            'interpolated': interpolated / max(detected, 1),
+        })
+
+    return results
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Idle sensing (decimation 1 is the full rate baseline):")
+    for result in simulate_idle_sensing(model, samples, labels):
+        print(f"  decimation {result['decimation']}: ADC duty cycle {result['adc_duty_cycle'] * 100:.1f}%, "
+              f"extra latency {result['mean_latency_ms']:.1f} ms, detected {result['detected'] * 100:.1f}%, accuracy {result['accuracy']:.4f}")
+        print(f"    {result['interpolated'] * 100:.1f}% of the captures start with interpolated samples, "
+              f"accuracy {result['accuracy_true_history']:.4f} with the full rate samples instead")
\ No newline at end of file
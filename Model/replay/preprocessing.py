@@ -0,0 +1,152 @@
+# The pre-processing variants of the Preprocessor: streaming, division free and batched over whole datasets.
+
+import time
+
+import numpy as np
+
+import batch_preprocessing
+import data_processing
+
+from replay.common import LOW_PASS_CUTOFF, NUM_DATAPOINTS, READ_PERIOD_MS, TFLiteModel
+
+def streaming_preprocess(raw_sample: np.ndarray) -> np.ndarray:
+    """
+    Preprocessor::feedSample and Preprocessor::finalizeStream: the raw samples are filtered while they come in,
+    with per channel maximum, sum and sum of squares, and the capture is rescaled once at the end.
+    The filter is linear, so its response to a constant signal corrects for the mean that is removed afterwards.
+    """
+    raw_sample = np.round(np.asarray(raw_sample, dtype=np.float64))
+    length = raw_sample.shape[0]
+
+    a, b = data_processing.butterworth_coefficients(1000 / READ_PERIOD_MS, LOW_PASS_CUTOFF)
+
+    filtered = np.zeros_like(raw_sample)
+    for n, x in enumerate(raw_sample):
+        filtered[n] = x
+        if n >= 2:
+            filtered[n] = b[0] * x + (a[0] + b[1]) * filtered[n - 1] + (a[1] + b[2]) * filtered[n - 2]
+
+    unit_response = data_processing.butterworth_filter(np.ones(length))
+
+    gain, offset = standardisation(raw_sample)
+    return filtered * gain - np.outer(unit_response, np.full(len(gain), offset))
+
+def standardisation(raw_sample: np.ndarray, rsqrt=lambda x: 1 / np.sqrt(x)) -> tuple:
+    """
+    Preprocessor::computeStandardisation: the gain of every channel and the offset that divide the raw samples by the
+    maximum of their channel, remove the mean of all channels and divide by their standard deviation.
+    The sums are taken on integers, like the firmware does.
+    """
+    raw_sample = np.round(np.asarray(raw_sample)).astype(np.int64)
+    length = raw_sample.shape[0]
+
+    maximum = np.max(raw_sample, axis=0)
+    total = np.sum(raw_sample, axis=0)
+    spread = length * np.sum(raw_sample ** 2, axis=0) - total ** 2
+
+    scale = np.where(maximum == 0, 1, 1 / np.maximum(maximum, 1))
+    channel_mean = total / length * scale
+    mean = np.mean(channel_mean)
+    variance = np.mean(spread / length ** 2 * scale ** 2 + (channel_mean - mean) ** 2)
+
+    inv_std = rsqrt(variance)
+    return scale * inv_std, mean * inv_std
+
+def fast_rsqrt(x: float) -> float:
+    """
+    FastMath::Rsqrt: the exponent trick followed by two Newton-Raphson steps, in single precision.
+    """
+    x = np.float32(x)
+    y = (np.uint32(0x5F375A86) - (np.array(x).view(np.uint32) >> np.uint32(1))).view(np.float32)
+    half_x = np.float32(0.5) * x
+    for _ in range(2):
+        y = y * (np.float32(1.5) - half_x * y * y)
+    return y
+
+def fast_preprocess(raw_sample: np.ndarray) -> np.ndarray:
+    """
+    Preprocessor::runFastPipeline in single precision: one multiply-add per sample for the max normalisation and the
+    z-score together, followed by the low pass filter.
+    """
+    gain, offset = standardisation(raw_sample, fast_rsqrt)
+    signal = np.round(np.asarray(raw_sample)).astype(np.float32) * gain.astype(np.float32) - np.float32(offset)
+    return np.apply_along_axis(data_processing.butterworth_filter, 0, signal)
+
+def verify_fast_math(samples: list) -> dict:
+    """
+    Compares the division free pre-processing with data_processing.preprocess_data, and FastMath::Rsqrt with 1 / sqrt
+    over the range of variances of max normalised signals. Timing on the host says nothing about the divides of the
+    microcontroller, the firmware times both pre-processings with BENCHMARK_PREPROCESSING.
+
+    Returns:
+        The largest deviation of the pre-processed gestures and the largest relative error of the reciprocal square root.
+    """
+    samples = [np.round(np.asarray(sample, dtype=np.float64)) for sample in samples]
+
+    reference = [data_processing.preprocess_data(sample) for sample in samples]
+    fast = [fast_preprocess(sample) for sample in samples]
+
+    variances = np.logspace(-6, 0, 2000)
+    rsqrt_error = max(abs(float(fast_rsqrt(v)) * np.sqrt(v) - 1) for v in variances)
+
+    return {
+        'deviation': max(np.max(np.abs(f - r)) for f, r in zip(fast, reference)),
+        'rsqrt_relative_error': rsqrt_error,
+    }
+
+def verify_streaming_preprocessing(samples: list) -> float:
+    """
+    Returns:
+        The largest deviation of the streaming pre-processing from data_processing.preprocess_data over the recorded gestures.
+    """
+    deviation = 0
+    for sample in samples:
+        sample = np.round(np.asarray(sample, dtype=np.float64))
+        deviation = max(deviation, np.max(np.abs(streaming_preprocess(sample) - data_processing.preprocess_data(sample))))
+
+    return deviation
+
+def benchmark_batch_preprocessing(samples: list, windows: int = 200000) -> dict:
+    """
+    Compares batch_preprocessing.preprocess_batch with data_processing.preprocess_data over the recorded gestures, and
+    times both on a dataset of the given number of windows made by repeating the recorded gestures.
+
+    Returns:
+        The largest deviation and the throughput of both in windows per second (host timing).
+    """
+    captures = np.array([np.round(np.asarray(sample, dtype=np.float64)) for sample in samples if len(sample) == NUM_DATAPOINTS])
+
+    batch = batch_preprocessing.preprocess_batch(captures, 1000 / READ_PERIOD_MS, LOW_PASS_CUTOFF)
+    deviation = max(np.max(np.abs(b - data_processing.preprocess_data(c))) for b, c in zip(batch, captures))
+
+    dataset = np.resize(captures, (windows,) + captures.shape[1:])
+
+    start = time.perf_counter()
+    batch_preprocessing.preprocess_batch(dataset, 1000 / READ_PERIOD_MS, LOW_PASS_CUTOFF)
+    batch_duration = time.perf_counter() - start
+
+    # The per window path is slow, it is timed on a part of the dataset
+    subset = dataset[:min(windows, 5000)]
+    start = time.perf_counter()
+    for capture in subset:
+        data_processing.preprocess_data(capture)
+    single_duration = time.perf_counter() - start
+
+    return {
+        'deviation': deviation,
+        'batch_windows_per_second': windows / batch_duration,
+        'single_windows_per_second': len(subset) / single_duration,
+    }
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Streaming pre-processing:")
+    print(f"  {verify_streaming_preprocessing(samples):.1e} from the pre-processing after the capture")
+
+    print("Division free pre-processing:")
+    fast_math = verify_fast_math(samples)
+    print(f"  {fast_math['deviation']:.1e} from the reference pre-processing, rsqrt relative error {fast_math['rsqrt_relative_error']:.1e}")
+
+    print("Batch pre-processing:")
+    batch = benchmark_batch_preprocessing(samples)
+    print(f"  {batch['deviation']:.1e} from the reference pre-processing, {batch['batch_windows_per_second']:.0f} windows/s "
+          f"instead of {batch['single_windows_per_second']:.0f} windows/s one window at a time (host)")
\ No newline at end of file
@@ -0,0 +1,109 @@
+# The fixed point resampler that maps captures of any length onto the time grid of the model (Resampler).
+
+import numpy as np
+
+from replay.common import NUM_DATAPOINTS, TFLiteModel
+
+RESAMPLER_TAPS = 8
+RESAMPLER_PHASES = 32
+
+def polyphase_coefficients(input_length: int, output_length: int, exact: bool = False) -> np.ndarray:
+    """
+    Windowed sinc filter of Resampler::Configure. Returns the Q14 taps of every phase like the firmware,
+    or with exact=True a function of the fractional position that gives the float taps without phase quantisation.
+    """
+    cutoff = (output_length - 1) / (input_length - 1) if input_length > output_length else 1.0
+
+    def taps(fraction):
+        distance = np.arange(RESAMPLER_TAPS) - (RESAMPLER_TAPS // 2 - 1) - fraction
+        window = 0.5 * (1 + np.cos(np.pi * distance / (RESAMPLER_TAPS // 2)))
+        taps = np.sinc(cutoff * distance) * window
+        return taps / np.sum(taps)
+
+    if exact:
+        return taps
+
+    coefficients = np.zeros((RESAMPLER_PHASES, RESAMPLER_TAPS), dtype=np.int64)
+    for phase in range(RESAMPLER_PHASES):
+        float_taps = taps(phase / RESAMPLER_PHASES)
+        coefficients[phase] = np.round(float_taps * 16384)
+        coefficients[phase, np.argmax(float_taps)] += 16384 - np.sum(coefficients[phase])
+    return coefficients
+
+def resample_fixed_point(signal: np.ndarray, output_length: int, mode: str = "linear") -> np.ndarray:
+    """
+    Resamples a signal of shape (time, sensors) like Resampler::Resample, with the 16.16 phase accumulator that carries
+    the remainder of the step, and either linear interpolation or the Q14 polyphase filter.
+    """
+    signal = signal.astype(np.int64)
+    length = len(signal)
+    positions = np.arange(output_length, dtype=np.int64) * ((length - 1) << 16) // (output_length - 1)
+    index = positions >> 16
+    fraction = positions & 0xFFFF
+
+    if mode == "linear":
+        following = np.minimum(index + 1, length - 1)
+        difference = np.where((index + 1 >= length)[:, None], 0, signal[following] - signal[np.minimum(index, length - 1)])
+        return (signal[np.minimum(index, length - 1)] + ((difference * fraction[:, None]) >> 16)).astype(np.float32)
+
+    coefficients = polyphase_coefficients(length, output_length)
+    phases = coefficients[fraction >> 11]
+    taps = np.clip(index[:, None] - RESAMPLER_TAPS // 2 + 1 + np.arange(RESAMPLER_TAPS), 0, length - 1)
+    accumulator = np.einsum('ot,ots->os', phases, signal[taps])
+    return np.clip((accumulator + (1 << 13)) >> 14, 0, 65535).astype(np.float32)
+
+def resample_float(signal: np.ndarray, output_length: int, mode: str = "linear") -> np.ndarray:
+    """
+    Float reference of resample_fixed_point, with exact positions and filter taps.
+    """
+    length = len(signal)
+    positions = np.arange(output_length) * (length - 1) / (output_length - 1)
+
+    if mode == "linear":
+        return np.stack([np.interp(positions, np.arange(length), signal[:, i]) for i in range(signal.shape[1])], axis=1)
+
+    taps = polyphase_coefficients(length, output_length, exact=True)
+    output = np.zeros((output_length, signal.shape[1]))
+    for j, position in enumerate(positions):
+        index = int(np.floor(position))
+        n = np.clip(index - RESAMPLER_TAPS // 2 + 1 + np.arange(RESAMPLER_TAPS), 0, length - 1)
+        output[j] = taps(position - index) @ signal[n]
+    return output
+
+def resample_capture(capture: np.ndarray, length: int) -> np.ndarray:
+    """
+    Stretches the first length samples of a capture over NUM_DATAPOINTS samples like GestureDetector::resampleCapture.
+    """
+    return resample_fixed_point(capture[:length], NUM_DATAPOINTS)
+
+def benchmark_resampler(samples: list, input_lengths: tuple = (40, 50, 150, 200)) -> list:
+    """
+    Resamples every recorded gesture to each input length and back onto the NUM_DATAPOINTS of the model, and compares
+    the fixed point resampler with its float reference. The time the firmware spends on it is printed at boot with
+    BENCHMARK_PREPROCESSING, the resampler itself is tested in GestureRecogniser/test/test_resampler.
+
+    Returns:
+        For every mode and input length the largest deviation from the float reference in ADC counts.
+    """
+    results = []
+    for mode in ("linear", "polyphase"):
+        for input_length in input_lengths:
+            signals = [np.round(resample_float(np.asarray(sample, dtype=np.float64), input_length)) for sample in samples]
+
+            deviation = 0
+            for signal in signals:
+                output = resample_fixed_point(signal, NUM_DATAPOINTS, mode)
+                deviation = max(deviation, np.max(np.abs(output - resample_float(signal, NUM_DATAPOINTS, mode))))
+
+            results.append({
+                'mode': mode,
+                'input_length': input_length,
+                'max_deviation': deviation,
+            })
+
+    return results
+
+def report(model: TFLiteModel, samples: list, labels: np.ndarray):
+    print("Resampler, largest deviation from the float reference:")
+    for result in benchmark_resampler(samples):
+        print(f"  {result['mode']} from {result['input_length']} samples: {result['max_deviation']:.2f} ADC counts")
\ No newline at end of file
@@ -0,0 +1,43 @@
+# This python file replays recorded gestures through the same steps the microcontroller program performs.
+# It is used to evaluate changes to the capture and inference logic of the GestureRecogniser without hardware.
+# The replay of every feature is in its own module of the replay package, run them all or name the ones to run:
+#   python replay_harness.py gate resampling
+
+import argparse
+
+from replay import (adaptive_capture, continuous, early_exit, early_prediction, filtering, gain, gate, hierarchical,
+                    idle_sensing, preprocessing, resampling)
+from replay.common import TFLiteModel, load_replay_data
+
+# In the order they are reported
+FEATURES = {
+    'early_prediction': early_prediction,
+    'continuous': continuous,
+    'gate': gate,
+    'gain': gain,
+    'idle_sensing': idle_sensing,
+    'adaptive_capture': adaptive_capture,
+    'resampling': resampling,
+    'filtering': filtering,
+    'preprocessing': preprocessing,
+    'hierarchical': hierarchical,
+    'early_exit': early_exit,
+}
+
+# These need the TFLite files written by export_hierarchical_models and export_early_exit_model, so only run when named
+EXPORTED_MODEL_FEATURES = ('hierarchical', 'early_exit')
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Replays the recorded gestures through the features of the firmware.")
+    parser.add_argument('features', nargs='*', choices=list(FEATURES), metavar='feature',
+                        help=f"features to replay, one of {', '.join(FEATURES)} (default: all that need no exported models)")
+    args = parser.parse_args()
+
+    features = args.features or [name for name in FEATURES if name not in EXPORTED_MODEL_FEATURES]
+
+    model = TFLiteModel()
+    samples, labels = load_replay_data()
+
+    print(f"Replaying {len(samples)} gestures")
+    for name in features:
+        FEATURES[name].report(model, samples, labels)
\ No newline at end of file
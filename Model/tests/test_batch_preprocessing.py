@@ -0,0 +1,63 @@
+# This python file checks batch_preprocessing against golden vectors of the firmware pre-processing, written by the
+# test_preprocessing_golden unit test of the GestureRecogniser. Run "python -m unittest discover tests" from the Model folder.
+
+import os
+import unittest
+
+import numpy as np
+
+import batch_preprocessing
+
+GOLDEN_FILE = os.path.join(os.path.dirname(__file__), '..', '..', 'GestureRecogniser', 'test', 'fixtures', 'preprocessing_golden.bin')
+
+# The header of the file, see test_preprocessing_golden.cpp
+HEADER = np.dtype([('magic', 'S4'), ('captures', '<u4'), ('channels', '<u4'), ('length', '<u4'), ('sample_rate', '<f4'), ('cutoff', '<f4')])
+
+def load_golden() -> tuple:
+    """
+    Reads the golden vectors.
+
+    Returns:
+        The raw captures and the outputs of the firmware, both with shape (captures, channels, length),
+        and the sample rate and cutoff of the low pass filter.
+    """
+    data = np.fromfile(GOLDEN_FILE, dtype=np.uint8)
+    header = data[:HEADER.itemsize].view(HEADER)[0]
+    if header['magic'] != b'PPGV':
+        raise ValueError(f"{GOLDEN_FILE} does not hold golden vectors")
+
+    shape = (int(header['captures']), int(header['channels']), int(header['length']))
+    raw_end = HEADER.itemsize + 2 * int(np.prod(shape))
+    raw = data[HEADER.itemsize:raw_end].view('<u2').reshape(shape)
+    output = data[raw_end:].view('<f4').reshape(shape)
+    return raw, output, float(header['sample_rate']), float(header['cutoff'])
+
+class BatchPreprocessingTest(unittest.TestCase):
+
+    def test_matches_the_firmware_bit_for_bit(self):
+        raw, expected, sample_rate, cutoff = load_golden()
+
+        # The engine takes captures as (windows, time, channels), the firmware stores them planar
+        actual = batch_preprocessing.preprocess_batch(raw.transpose(0, 2, 1), sample_rate, cutoff).transpose(0, 2, 1)
+
+        # Compared as bits, so the sign of zero counts too
+        mismatches = np.argwhere(actual.view(np.uint32) != expected.view(np.uint32))
+        if len(mismatches):
+            capture, channel, sample = mismatches[0]
+            self.fail(f"{len(mismatches)} samples differ, the first in capture {capture}, channel {channel}, sample {sample}: "
+                      f"{actual[capture, channel, sample]!r} instead of {expected[capture, channel, sample]!r}")
+
+    def test_chunks_do_not_change_the_result(self):
+        raw, expected, sample_rate, cutoff = load_golden()
+
+        chunk_windows = batch_preprocessing.CHUNK_WINDOWS
+        batch_preprocessing.CHUNK_WINDOWS = 5
+        try:
+            actual = batch_preprocessing.preprocess_batch(raw.transpose(0, 2, 1), sample_rate, cutoff, workers=3)
+        finally:
+            batch_preprocessing.CHUNK_WINDOWS = chunk_windows
+
+        np.testing.assert_array_equal(actual.transpose(0, 2, 1).view(np.uint32), expected.view(np.uint32))
+
+if __name__ == '__main__':
+    unittest.main()
\ No newline at end of file